@@ -0,0 +1,423 @@
+// Throughput benchmark of the decoding path, without Logic.
+// WorkerThread, addCommandFrame and GenerateExportFile need the Logic runtime,
+// so this drives what they are made of instead: HKWire::Decoder for
+// edges -> bits -> words -> commands, the same name lookups as addCommandFrame,
+// and a copy of the hexadecimal rows of GenerateExportFile on an ExportWriter.
+//
+// Synthetic traffic from the TrafficGenerator is decoded at several sample rates
+// and traffic mixes. Results can be stored as baseline and compared against later;
+// the exit code is 1 if any scenario got slower (or allocates more) than allowed.
+// The numbers only mean something on the machine that wrote the baseline,
+// `--advisory` reports regressions without failing.
+
+#include "HKWireDecoder.h"
+#include "HKWireExport.h"
+#include "HKWireTrafficGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace HKWire;
+
+// -------- ALLOCATION COUNTING
+
+namespace
+{
+	bool gCountAllocations = false;
+	U64 gAllocatedBytes = 0;
+}
+
+void*
+operator new(std::size_t size)
+{
+	if (gCountAllocations)
+	{
+		gAllocatedBytes += size;
+	}
+	if (void* ptr = std::malloc(size ? size : 1))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+namespace
+{
+	struct Options
+	{
+		U64 numCommands = 100000;
+		unsigned repeat = 5;
+		double tolerance = 0.25;
+		const char* baseline = nullptr;
+		const char* writeBaseline = nullptr;
+		const char* filter = nullptr;
+		bool advisory = false;
+	};
+
+	struct Mix
+	{
+		const char* name;
+		double data8Ratio;
+		double data16Ratio;
+		double tickJitter;
+		double glitchProbability;
+		double glitch_ticks;	// of the decoder, see GlitchFilter
+	};
+
+	constexpr Mix mixes[] =
+	{
+		{"plain",  0,   0,   0.1,  0,     0},
+		{"mixed",  0.2, 0.2, 0.1,  0,     0},
+		// the default of the analyzer, what the filter costs on clean edges
+		{"mixed-deglitch", 0.2, 0.2, 0.1, 0, GlitchFilter::defaultWidth_ticks},
+		{"data16", 0,   1,   0.1,  0,     0},
+		{"noisy",  0.2, 0.2, 0.35, 0.002, 0},
+		{"noisy-deglitch", 0.2, 0.2, 0.35, 0.002, GlitchFilter::defaultWidth_ticks},
+	};
+
+	constexpr U64 sampleRates_Hz[] =
+	{
+		1000000,
+		24000000,
+		100000000,
+		500000000,
+	};
+
+	struct Result
+	{
+		double edgesPerSecond = 0;
+		double framesPerSecond = 0;
+		double bytesPerFrame = 0;
+		double exportFramesPerSecond = 0;
+	};
+
+	// what the analyzer hands to AddFrame / AddFrameV2 for a command
+	struct FrameRecord
+	{
+		U64 start;
+		U64 end;
+		U64 serialized;
+		U64 wordOffsets;
+		std::optional<const char*> srcName;
+		std::optional<const char*> dstName;
+		std::optional<const char*> commandName;
+	};
+
+	class BenchListener : public DecoderListener
+	{
+	public:
+		void
+		onMarker(const U64&, const Marker&, const HKWireState&) override
+		{
+			numMarkers++;
+		}
+
+		void
+		onCommand(const CommandRecord& record) override
+		{
+			const auto& payload = record.payload;
+			const ID src = payload.getWord(WordState::source);
+			const ID dst = payload.getWord(WordState::dest);
+			const Command cmd = payload.getWord(WordState::command);
+			commands.push_back(FrameRecord{record.start, record.end,
+			                                 payload.getSerialized(), record.getPackedWordOffsets(),
+			                                 getNameOfID(src), getNameOfID(dst),
+			                                 getNameOfCommand(dst, cmd)});
+		}
+
+		U64 numMarkers = 0;
+		std::vector<FrameRecord> commands;
+	};
+
+#ifdef _WIN32
+	constexpr const char* nullDevice = "NUL";
+#else
+	constexpr const char* nullDevice = "/dev/null";
+#endif
+
+	// Same writer and formatting steps as the hexadecimal GenerateExportFile
+	void
+	exportCommands(const std::vector<FrameRecord>& commands, const U64& sampleRate_Hz)
+	{
+		ExportWriter writer(nullDevice);
+		writer.text("Time [s],Type,Src,Dst,Cmd,Dat\n");
+		for (const auto& record : commands)
+		{
+			const auto payload = Payload(record.serialized);
+			const bool withData = payload.data1.has_value();
+			writer.time(record.start, 0, sampleRate_Hz);
+			writer.text(withData ? ",command with data," : ",command,");
+			writer.hex(payload.source, *getBitsPerWord(WordState::source));
+			writer.put(',');
+			writer.hex(payload.dest, *getBitsPerWord(WordState::dest));
+			writer.put(',');
+			writer.hex(payload.command, *getBitsPerWord(WordState::command));
+			if (withData)
+			{
+				writer.put(',');
+				writer.hex(payload.getDataInHostOrder(), payload.getDataLength());
+			}
+			writer.put('\n');
+		}
+	}
+
+	std::vector<U64>
+	generateEdges(const TrafficConfig& config, const U64& numCommands)
+	{
+		std::vector<U64> edges;
+		TrafficGenerator generator(config);
+		while (true)
+		{
+			const auto edge = generator.nextEdge();
+			if (generator.getNumTransmissions() > numCommands)
+			{
+				break;
+			}
+			edges.push_back(edge);
+		}
+		return edges;
+	}
+
+	using Clock = std::chrono::steady_clock;
+
+	Result
+	run(const Mix& mix, const U64& sampleRate_Hz, const Options& options)
+	{
+		TrafficConfig config;
+		config.sampleRate_Hz = sampleRate_Hz;
+		config.data8Ratio = mix.data8Ratio;
+		config.data16Ratio = mix.data16Ratio;
+		config.tickJitter = mix.tickJitter;
+		config.glitchProbability = mix.glitchProbability;
+		const auto edges = generateEdges(config, options.numCommands);
+		const auto tickLength = TickLength::fromTimeBase(config.timeBase_us, sampleRate_Hz);
+
+		Result result;
+		double bestDecode = 1e300;
+		double bestExport = 1e300;
+		for (unsigned i = 0; i < options.repeat; i++)
+		{
+			BenchListener listener;
+			// the listener only stands in for Logic, its growth would hide what the decoder allocates
+			listener.commands.reserve(options.numCommands + 1);
+
+			// decoding and export, both should not allocate per frame
+			gAllocatedBytes = 0;
+			gCountAllocations = true;
+			const auto begin = Clock::now();
+			Decoder decoder(listener, tickLength, PulseTolerance{}, mix.glitch_ticks);
+			decoder.decode(edges);
+			decoder.finish();
+			const std::chrono::duration<double> decodeTime = Clock::now() - begin;
+
+			const auto exportBegin = Clock::now();
+			exportCommands(listener.commands, sampleRate_Hz);
+			const std::chrono::duration<double> exportTime = Clock::now() - exportBegin;
+			gCountAllocations = false;
+
+			const double numFrames = std::max<size_t>(1, listener.commands.size());
+			bestDecode = std::min(bestDecode, decodeTime.count());
+			bestExport = std::min(bestExport, exportTime.count());
+			result.edgesPerSecond = edges.size() / bestDecode;
+			result.framesPerSecond = numFrames / bestDecode;
+			result.bytesPerFrame = gAllocatedBytes / numFrames;
+			result.exportFramesPerSecond = numFrames / bestExport;
+		}
+		return result;
+	}
+
+	std::string
+	scenarioName(const Mix& mix, const U64& sampleRate_Hz)
+	{
+		return std::string(mix.name) + "@" + std::to_string(sampleRate_Hz / 1000000) + "MHz";
+	}
+
+	std::map<std::string, Result>
+	readBaseline(const char* path)
+	{
+		std::map<std::string, Result> baseline;
+		std::ifstream in(path);
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			char name[64];
+			Result result;
+			if (std::sscanf(line.c_str(), "%63[^,],%lf,%lf,%lf,%lf", name,
+			                &result.edgesPerSecond, &result.framesPerSecond,
+			                &result.bytesPerFrame, &result.exportFramesPerSecond) == 5)
+			{
+				baseline[name] = result;
+			}
+		}
+		return baseline;
+	}
+
+	void
+	printUsage(const char* name)
+	{
+		std::fprintf(stderr,
+			"usage: %s [options]\n"
+			"  -n, --commands N         commands per scenario (default 100000)\n"
+			"      --repeat N           runs per scenario, the best counts (default 5)\n"
+			"  -f, --filter TEXT        only scenarios containing TEXT\n"
+			"      --baseline FILE      fail if slower than FILE allows\n"
+			"      --tolerance RATIO    allowed slowdown against the baseline (default 0.25)\n"
+			"      --write-baseline FILE  store the results as new baseline\n"
+			"      --advisory           report regressions, but exit with 0\n",
+			name);
+	}
+
+	std::optional<Options>
+	parseArguments(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if ((arg == "-n" || arg == "--commands") && hasValue)
+			{
+				options.numCommands = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if (arg == "--repeat" && hasValue)
+			{
+				options.repeat = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if ((arg == "-f" || arg == "--filter") && hasValue)
+			{
+				options.filter = argv[++i];
+			}
+			else if (arg == "--baseline" && hasValue)
+			{
+				options.baseline = argv[++i];
+			}
+			else if (arg == "--tolerance" && hasValue)
+			{
+				options.tolerance = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--write-baseline" && hasValue)
+			{
+				options.writeBaseline = argv[++i];
+			}
+			else if (arg == "--advisory")
+			{
+				options.advisory = true;
+			}
+			else
+			{
+				return std::nullopt;
+			}
+		}
+		return options;
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	const auto maybeOptions = parseArguments(argc, argv);
+	if (!maybeOptions.has_value())
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+	const auto& options = *maybeOptions;
+
+	std::map<std::string, Result> baseline;
+	if (options.baseline != nullptr)
+	{
+		baseline = readBaseline(options.baseline);
+		if (baseline.empty())
+		{
+			std::fprintf(stderr, "no usable baseline in %s\n", options.baseline);
+			return 2;
+		}
+	}
+
+	std::FILE* write = nullptr;
+	if (options.writeBaseline != nullptr)
+	{
+		write = std::fopen(options.writeBaseline, "w");
+		if (write == nullptr)
+		{
+			std::perror(options.writeBaseline);
+			return 2;
+		}
+		std::fputs("# scenario,edges/s,frames/s,bytes/frame,export frames/s\n", write);
+	}
+
+	std::printf("%-24s %12s %12s %12s %14s\n",
+	            "scenario", "Medges/s", "kframes/s", "bytes/frame", "export kfr/s");
+	bool regressed = false;
+	for (const auto& mix : mixes)
+	{
+		for (const auto& sampleRate_Hz : sampleRates_Hz)
+		{
+			const auto name = scenarioName(mix, sampleRate_Hz);
+			if (options.filter != nullptr && name.find(options.filter) == std::string::npos)
+			{
+				continue;
+			}
+			const auto result = run(mix, sampleRate_Hz, options);
+			std::printf("%-24s %12.2f %12.1f %12.1f %14.1f", name.c_str(),
+			            result.edgesPerSecond / 1e6, result.framesPerSecond / 1e3,
+			            result.bytesPerFrame, result.exportFramesPerSecond / 1e3);
+
+			if (write != nullptr)
+			{
+				std::fprintf(write, "%s,%.0f,%.0f,%.1f,%.0f\n", name.c_str(),
+				             result.edgesPerSecond, result.framesPerSecond,
+				             result.bytesPerFrame, result.exportFramesPerSecond);
+			}
+
+			const auto base = baseline.find(name);
+			if (base != baseline.end())
+			{
+				const auto& expected = base->second;
+				const double minimum = 1 - options.tolerance;
+				const bool slower = result.edgesPerSecond < expected.edgesPerSecond * minimum ||
+				                    result.exportFramesPerSecond < expected.exportFramesPerSecond * minimum;
+				// requested bytes, the same on every machine, so any allocation per frame shows
+				const bool fatter = result.bytesPerFrame > expected.bytesPerFrame * (1 + options.tolerance) + 1;
+				if (slower || fatter)
+				{
+					std::printf("  REGRESSION (baseline %.2f Medges/s, %.1f bytes/frame, %.1f export kfr/s)",
+					            expected.edgesPerSecond / 1e6, expected.bytesPerFrame,
+					            expected.exportFramesPerSecond / 1e3);
+					regressed = true;
+				}
+			}
+			std::printf("\n");
+			std::fflush(stdout);
+		}
+	}
+
+	if (write != nullptr)
+	{
+		std::fclose(write);
+	}
+	return regressed && !options.advisory ? 1 : 0;
+}
@@ -1,31 +1,51 @@
 #!/usr/bin/python
 
 import csv
+import mmap
+import struct
+import sys
 
+filename = sys.argv[1] if len(sys.argv) > 1 else 'einmal alles.csv'
 data = []
 isProbablyHex = True
 
 expected_header = ("Time [s]", "Type", "Src", "Dst", "Cmd", "Dat")
-with open('einmal alles.csv') as csvfile:
-    reader = csv.reader(csvfile)
-    first_row = next(reader)
-    if first_row is not expected_header:
-        print ("Not expected header")
-        print ("expected: " + str(expected_header))
-        print ("actual  : " + str(first_row))
-
-    for row in reader:
-        # print(', '.join(row))
-        time = float(row[0])
-        type = row[1]
-        src = int(row[2], 0)
-        dst = int(row[3], 0)
-        cmd = int(row[4], 0)
-        dat = None
-        if len(row) > 5 and "with data" in type:
-            dat = int(row[5], 0)
-        parsed_row = (time, type, src, dst, cmd, dat)
-        data.append(parsed_row)
+def load_csv(filename):
+    with open(filename) as csvfile:
+        reader = csv.reader(csvfile)
+        first_row = next(reader)
+        if first_row is not expected_header:
+            print ("Not expected header")
+            print ("expected: " + str(expected_header))
+            print ("actual  : " + str(first_row))
+
+        for row in reader:
+            # print(', '.join(row))
+            time = float(row[0])
+            type = row[1]
+            src = int(row[2], 0)
+            dst = int(row[3], 0)
+            cmd = int(row[4], 0)
+            dat = None
+            if len(row) > 5 and "with data" in type:
+                dat = int(row[5], 0)
+            parsed_row = (time, type, src, dst, cmd, dat)
+            data.append(parsed_row)
+
+def load_binary(filename):
+    # binary export of the analyzer, layout in src/HKWireBinaryExport.h
+    with open(filename, 'rb') as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+        _, rate, trigger, record_size, _ = struct.unpack_from('<8sQQII', m, 0)
+        num_records = struct.unpack_from('<Q', m, len(m) - 32)[0]
+        for offset in range(32, 32 + num_records * record_size, record_size):
+            start, _, src, dst, cmd, length, dat = struct.unpack_from('<QQBBBBH', m, offset)
+            type = "command with data" if length else "command"
+            data.append(((start - trigger) / rate, type, src, dst, cmd, dat if length else None))
+
+if filename.endswith('.hkw'):
+    load_binary(filename)
+else:
+    load_csv(filename)
 
 
 unique_src = set(row[2] for row in data)
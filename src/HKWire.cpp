@@ -1,63 +1,103 @@
 #include "HKWire.h"
 
+#include <cstdio>
+
 using namespace HKWire;
 
-const IdDescriptionMap HKWire::knownIDs =
+namespace
 {
-    {0x0, "Tuner"},
-    {0x3, "Tape"},
-    {0x4, "Amp (?)"},
-};
+    // BCD-Like MM:SS, e.g. `0x0159` for 01:59
+    int
+    decodeTime(const Payload& payload, const bool negative, char* buffer, size_t size)
+    {
+        if (!payload.data2.has_value())
+        {
+            return -1;
+        }
+        const DataWord minutes = *payload.data1;
+        const DataWord seconds = *payload.data2;
+        return std::snprintf(buffer, size, "%s%u%u:%u%u", negative ? "-" : "",
+                             minutes >> 4, minutes & 0xF, seconds >> 4, seconds & 0xF);
+    }
 
-const CommandDescriptionMap ampCommands =
-{
-    {0x06, "set off?"},
-    {0x07, "set mute??"},
-    {0x13, "set input to Tape?"},
-};
+    int
+    decodePositiveTime(const Payload& payload, char* buffer, size_t size)
+    {
+        return decodeTime(payload, false, buffer, size);
+    }
 
-const CommandDescriptionMap tunerCommands =
-{
-    // probably broadcasts.
-    {0x01, "System On"},
-    {0x02, "System Off"},
-    {0x05, "Stop all"},
-
-    // Status
-    {0x06, "Device not playing"},
-    {0x07, "Device is  playing"},
-    {0x0B, "Current FF/FR speed"},
-    {0x0C, "Set time to display"},
-    {0x0D, "Set neg. time to display"},
-    {0x0F, "Tape deck present (?)"},
-    {0x10, "Tape playing forward"},
-    {0x11, "Tape playing reverse"},
-    {0x14, "NOT able to record"},
-    {0x15, "Able to record"},
-};
-
-const CommandDescriptionMap tapeDeckCommands =
-{
-    {0x07, "Eject ?"},
-    {0x08, "Increase FF speed"},
-    {0x09, "Increase FR speed"},
-    {0x0A, "FF ?"},
-    {0x0B, "FR ?"},
-    {0x0E, "Set Dolby: B"},
-    {0x0F, "Set Dolby: C"},
-    {0x10, "Set Dolby: None"},
-    {0x11, "Reverse playing direction"},
-    {0x15, "Request to record"},
-    {0x16, "Pause"},
-    {0x17, "Play"},
-    {0x1C, "Ok to go?"},
-    {0x1E, "Record"},
-    {0x1F, "Zero time counter"},
-};
-
-const TargetCommandDescriptionMap HKWire::knownCommands =
-{
-    {0x0, tunerCommands},
-    {0x3, tapeDeckCommands},
-    {0x4, ampCommands},
-};
\ No newline at end of file
+    int
+    decodeNegativeTime(const Payload& payload, char* buffer, size_t size)
+    {
+        return decodeTime(payload, true, buffer, size);
+    }
+
+    // lower nibble = speed (1-4), MSBit = isReverse
+    int
+    decodeFFSpeed(const Payload& payload, char* buffer, size_t size)
+    {
+        if (!payload.data1.has_value())
+        {
+            return -1;
+        }
+        const DataWord data = *payload.data1;
+        // "×" in UTF-8, regardless of the compiler's execution charset
+        return std::snprintf(buffer, size, "%u\xC3\x97 %s", data & 0x0F, data & 0x80 ? "backward" : "forward");
+    }
+
+    constexpr ID tuner = 0x0;
+    constexpr ID tapeDeck = 0x3;
+    constexpr ID amp = 0x4;
+
+    constexpr KnownID ids[] =
+    {
+        {tuner, "Tuner"},
+        {tapeDeck, "Tape"},
+        {amp, "Amp (?)"},
+    };
+
+    constexpr KnownCommand commands[] =
+    {
+        {amp, 0x06, "set off?"},
+        {amp, 0x07, "set mute??"},
+        {amp, 0x13, "set input to Tape?"},
+
+        // probably broadcasts.
+        {tuner, 0x01, "System On"},
+        {tuner, 0x02, "System Off"},
+        {tuner, 0x05, "Stop all"},
+
+        // Status
+        {tuner, 0x06, "Device not playing"},
+        {tuner, 0x07, "Device is  playing"},
+        {tuner, 0x0B, "Current FF/FR speed", decodeFFSpeed},
+        {tuner, 0x0C, "Set time to display", decodePositiveTime},
+        {tuner, 0x0D, "Set neg. time to display", decodeNegativeTime},
+        {tuner, 0x0F, "Tape deck present (?)"},
+        {tuner, 0x10, "Tape playing forward"},
+        {tuner, 0x11, "Tape playing reverse"},
+        {tuner, 0x14, "NOT able to record"},
+        {tuner, 0x15, "Able to record"},
+
+        {tapeDeck, 0x07, "Eject ?"},
+        {tapeDeck, 0x08, "Increase FF speed"},
+        {tapeDeck, 0x09, "Increase FR speed"},
+        {tapeDeck, 0x0A, "FF ?"},
+        {tapeDeck, 0x0B, "FR ?"},
+        {tapeDeck, 0x0E, "Set Dolby: B"},
+        {tapeDeck, 0x0F, "Set Dolby: C"},
+        {tapeDeck, 0x10, "Set Dolby: None"},
+        {tapeDeck, 0x11, "Reverse playing direction"},
+        {tapeDeck, 0x15, "Request to record"},
+        {tapeDeck, 0x16, "Pause"},
+        {tapeDeck, 0x17, "Play"},
+        {tapeDeck, 0x1C, "Ok to go?"},
+        {tapeDeck, 0x1E, "Record"},
+        {tapeDeck, 0x1F, "Zero time counter"},
+    };
+}
+
+const std::span<const KnownID> HKWire::knownIDs = ids;
+const std::span<const KnownCommand> HKWire::knownCommands = commands;
+
+constinit const CommandDictionary HKWire::commandDictionary = makeCommandDictionary(ids, commands);
\ No newline at end of file
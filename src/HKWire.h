@@ -5,8 +5,8 @@
 #include <optional>
 #include <utility>
 #include <array>
+#include <span>
 #include <assert.h>
-#include <map>	// until something static memory is available
 
 namespace HKWire
 {
@@ -70,6 +70,19 @@ namespace HKWire
 		}
 	}
 
+	constexpr
+	Bits
+	getMaxBitsPerTransmission()
+	{
+		Bits bits = 0;
+		for (std::underlying_type_t<WordState> i = 0; i < std::to_underlying(WordState::_num); i++)
+		{
+			bits += getBitsPerWord(static_cast<WordState>(i)).value_or(0);
+		}
+		return bits;
+	}
+	static_assert(getMaxBitsPerTransmission() == 34, "calculation is wrong?");
+
 	enum class BitType
 	{
 		start = 0,
@@ -164,26 +177,69 @@ namespace HKWire
 	static_assert(*getBitFromWaveform(Waveform{11}) == BitType::start, "start no workey werkoy");
 	static_assert(*getBitFromWaveform(Waveform{2}) == BitType::data0, "data0 no workey werkoy");
 
+	// Samples per tick, as 48.16 fixed point.
+	// Whole samples are too coarse at low sample rates (4.48 samples per tick at 8 kHz),
+	// doubles are slower than they need to be for every pulse.
+	struct TickLength
+	{
+		static constexpr unsigned fractionBits = 16;
+		static constexpr U64 one = U64(1) << fractionBits;
+
+		U64 raw;
+
+		static constexpr
+		TickLength
+		fromSamples(const U64& samples)
+		{
+			return TickLength{samples << fractionBits};
+		}
+
+		static constexpr
+		TickLength
+		fromTimeBase(const U64& timeBase_us, const U64& sampleRate_Hz)
+		{
+			// sample rate times time base fits easily, shifted it might not
+			const U64 samplesPerMegaTick = sampleRate_Hz * timeBase_us;
+			constexpr U64 mega = 1000 * 1000;
+			return TickLength{((samplesPerMegaTick / mega) << fractionBits) +
+			                  ((samplesPerMegaTick % mega) << fractionBits) / mega};
+		}
+
+		// rounded to whole samples
+		constexpr
+		U64
+		getSamples() const
+		{
+			return (raw + one / 2) >> fractionBits;
+		}
+
+		constexpr bool operator==(const TickLength& other) const = default;
+	};
+	static_assert(TickLength::fromTimeBase(560, 24000000) == TickLength::fromSamples(13440), "calculation is wrong?");
+	static_assert(TickLength::fromTimeBase(560, 8000).raw == 293601, "calculation is wrong?");	// 4.48
+
 	constexpr
 	U64
-	getSamplesPerTick(const U32& timeBase_us, const U32& sampleRate_Hz)
+	getSamplesPerTick(const U64& timeBase_us, const U64& sampleRate_Hz)
 	{
-		const U32 samplesPerTimeBase = sampleRate_Hz / ((1000 * 1000) / timeBase_us);
-		return samplesPerTimeBase;
+		return TickLength::fromTimeBase(timeBase_us, sampleRate_Hz).getSamples();
 	}
 	static_assert(getSamplesPerTick(560, 8000) >= 4, "calculation is wrong?");
+	static_assert(getSamplesPerTick(560, 24000000) == 13440, "calculation is wrong?");
 
 	static constexpr
 	Ticks
-	matchSamplesToTicks(const U32& samplesPerTick, const U32& recordedSamples)
+	matchSamplesToTicks(const U64& samplesPerTick, const U64& recordedSamples)
 	{
-		const U32 wholeDivisions = recordedSamples / samplesPerTick;
-		const U32 rest = recordedSamples % samplesPerTick;
-		const Ticks ticks = rest > (samplesPerTick / 2) ? wholeDivisions + 1 : wholeDivisions;
-		return ticks;
+		const U64 wholeDivisions = recordedSamples / samplesPerTick;
+		const U64 rest = recordedSamples % samplesPerTick;
+		const U64 ticks = rest > (samplesPerTick / 2) ? wholeDivisions + 1 : wholeDivisions;
+		// anything this long is not a valid bit anyway, and must not wrap into one
+		return ticks > maxLowTicks ? maxLowTicks + 1 : ticks;
 	}
 	static_assert(matchSamplesToTicks(20, 30) == 1, "calculation is wrong?");
 	static_assert(matchSamplesToTicks(20, 31) == 2, "calculation is wrong?");
+	static_assert(matchSamplesToTicks(20, (U64(1) << 32) * 20 + 40) == maxLowTicks + 1, "calculation is wrong?");
 
 
 	// ----- PROTOCOL LEVEL
@@ -303,12 +359,24 @@ namespace HKWire
 			}
 		}
 
+		// the last word with data
+		constexpr
+		WordState
+		getLastWord() const
+		{
+			if (data2.has_value())
+			{
+				return WordState::data2;
+			}
+			return data1.has_value() ? WordState::data1 : WordState::command;
+		}
+
 		constexpr
 		size_t
 		getDataLength() const
 		{
-			return data1.has_value() ? *getBitsPerWord(WordState::data1) : 0
-			       + data2.has_value() ? *getBitsPerWord(WordState::data2) : 0;
+			return (data1.has_value() ? *getBitsPerWord(WordState::data1) : 0)
+			       + (data2.has_value() ? *getBitsPerWord(WordState::data2) : 0);
 		}
 
 		constexpr
@@ -338,13 +406,13 @@ namespace HKWire
 	// AKA: One Transmission
 	struct HKWireState
 	{
-		U32 startOfTransmission;
-		U32 startOfCurrentWord;
+		U64 startOfTransmission;
+		U64 startOfCurrentWord;
 		Bits currentNumberOfBitsReceived;
 		WordState wordState;	// read: _expecting_ this state.
 		Payload payload;
 
-		constexpr HKWireState(U32 startOfTransmission = 0)
+		constexpr HKWireState(U64 startOfTransmission = 0)
 			: startOfTransmission{startOfTransmission},
 			  startOfCurrentWord{startOfTransmission},
 			  currentNumberOfBitsReceived{0},
@@ -429,10 +497,98 @@ namespace HKWire
 		}
 	}
 
-	using IdDescriptionMap = std::map<ID, const char*>;
-	using CommandDescriptionMap = std::map<HKWire::Command, const char*>;
-	using TargetCommandDescriptionMap = std::map<ID, const CommandDescriptionMap&>;
+	// Writes a human readable form of the data words into `buffer`,
+	// returns the length like snprintf does.
+	using DataDecoder = int (*)(const Payload& payload, char* buffer, size_t size);
+
+	struct KnownID
+	{
+		ID id;
+		const char* name;
+	};
+
+	struct KnownCommand
+	{
+		ID dest;
+		HKWire::Command command;
+		const char* name;
+		DataDecoder decodeData = nullptr;
+	};
+
+	// everything we know, in the order it was found out
+	extern const std::span<const KnownID> knownIDs;
+	extern const std::span<const KnownCommand> knownCommands;
+
+	struct CommandDescription
+	{
+		const char* name = nullptr;
+		DataDecoder decodeData = nullptr;
+	};
+
+	static constexpr size_t numIDs = 1 << 4;
+	static constexpr size_t numCommands = 1 << 8;
+
+	// Dense lookup of the above, one entry for every ID and every command to it.
+	struct CommandDictionary
+	{
+		std::array<const char*, numIDs> ids{};
+		std::array<std::array<CommandDescription, numCommands>, numIDs> commands{};
+	};
+
+	constexpr
+	CommandDictionary
+	makeCommandDictionary(std::span<const KnownID> ids, std::span<const KnownCommand> commands)
+	{
+		CommandDictionary dictionary;
+		for (const auto& known : ids)
+		{
+			dictionary.ids[known.id & 0xF] = known.name;
+		}
+		for (const auto& known : commands)
+		{
+			dictionary.commands[known.dest & 0xF][known.command] = CommandDescription{known.name, known.decodeData};
+		}
+		return dictionary;
+	}
+
+	extern const CommandDictionary commandDictionary;
+
+	inline
+	const CommandDescription&
+	getCommandDescription(const ID& dest, const Command& command)
+	{
+		return commandDictionary.commands[dest & 0xF][command];
+	}
+
+	// nullopt if unknown
+	inline
+	std::optional<const char*>
+	getNameOfID(const ID& id)
+	{
+		const auto name = commandDictionary.ids[id & 0xF];
+		return name != nullptr ? std::optional<const char*>{name} : std::nullopt;
+	}
+
+	inline
+	std::optional<const char*>
+	getNameOfCommand(const ID& dest, const Command& command)
+	{
+		const auto name = getCommandDescription(dest, command).name;
+		return name != nullptr ? std::optional<const char*>{name} : std::nullopt;
+	}
 
-	extern const IdDescriptionMap knownIDs;
-	extern const TargetCommandDescriptionMap knownCommands;
+	// Meaning of the data words, if there is a decoder for this command.
+	// Returns false if not, or if the data does not fit the decoder.
+	inline
+	bool
+	decodeData(const Payload& payload, char* buffer, size_t size)
+	{
+		const auto decoder = getCommandDescription(payload.dest, payload.command).decodeData;
+		if (decoder == nullptr || !payload.data1.has_value())
+		{
+			return false;
+		}
+		const auto length = decoder(payload, buffer, size);
+		return length > 0 && size_t(length) < size;
+	}
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #include "HKWireAnalyzer.h"
 #include "HKWireAnalyzerSettings.h"
 #include "HKWire.h"
+#include "HKWireTimeBase.h"
 #include <AnalyzerChannelData.h>
 
-#include <iostream>
+#include <algorithm>
 
 using namespace HKWire;
 using namespace std;
@@ -11,7 +12,22 @@ using namespace std;
 
 HKWireAnalyzer::HKWireAnalyzer()
 :	Analyzer2(),
-	mSettings( new HKWireAnalyzerSettings() )
+	mSettings( new HKWireAnalyzerSettings() ),
+	mTickLength{ 0 },
+	mSamplesPerTick( 0 ),
+	mMinLevel_samples( 0 ),
+	mHasHeldEdge( false ),
+	mHeldEdge( 0 ),
+	mDataLow( false ),
+	mNumSuppressedGlitches( 0 ),
+	mNumSuppressedGlitchesReported( 0 ),
+	mBusyData( nullptr ),
+	mBusyHeld( false ),
+	mBusyFreeSince( 0 ),
+	mInTransmission( false ),
+	mBusyHeldAtStart( false ),
+	mNumPendingMarkers( 0 ),
+	mSimulationInitilized( false )
 {
 	SetAnalyzerSettings( mSettings.get() );
 	UseFrameV2();
@@ -27,285 +43,520 @@ void HKWireAnalyzer::SetupResults()
 	mResults.reset( new HKWireAnalyzerResults( this, mSettings.get() ) );
 	SetAnalyzerResults( mResults.get() );
 	mResults->AddChannelBubblesWillAppearOn( mSettings->mDataChannel );
+	if (mSettings->hasBusyChannel())
+	{
+		mResults->AddChannelBubblesWillAppearOn( mSettings->mOptionalBusyChannel );
+	}
 }
 
-void HKWireAnalyzer::WorkerThread()
+TickLength HKWireAnalyzer::GetTickLength() const
 {
-	const auto sampleRateHz = GetSampleRate();
-	const auto samplesPerTick = getSamplesPerTick(mSettings->mTimeBase_us, sampleRateHz);
+	return mTickLength;
+}
 
-	HKWireState state;
+U64 HKWireAnalyzer::takeEdge()
+{
+	mDataLow = !mDataLow;
+	if (mHasHeldEdge)
+	{
+		mHasHeldEdge = false;
+		return mHeldEdge;
+	}
+	mChannelData->AdvanceToNextEdge();
+	return mChannelData->GetSampleNumber();
+}
 
-	mChannelData = GetAnalyzerChannelData( mSettings->mDataChannel );
+bool HKWireAnalyzer::isGlitch( const U64& edge )
+{
+	if (mMinLevel_samples == 0)
+	{
+		return false;
+	}
+	// Like HKWire::GlitchFilter, after the fact: the edge after this one is needed anyway,
+	// so clean edges cost no look ahead.
+	mChannelData->AdvanceToNextEdge();
+	const U64 next = mChannelData->GetSampleNumber();
+	if (next - edge >= mMinLevel_samples)
+	{
+		mHeldEdge = next;
+		mHasHeldEdge = true;
+		return false;
+	}
+	// the line never really left the level before
+	mDataLow = !mDataLow;
+	mNumSuppressedGlitches++;
+	return true;
+}
 
+U64 HKWireAnalyzer::advanceToNextEdge()
+{
 	for( ; ; )
 	{
-		mChannelData->AdvanceToNextEdge();
-		if( mChannelData->GetBitState() != BIT_LOW )
+		const U64 edge = takeEdge();
+		if (!isGlitch( edge ))
 		{
-			// We look for transitions from HIGH to LOW, so skip this one
-			continue;
+			return edge;
 		}
-		const auto fallingEdge = mChannelData->GetSampleNumber();
-		mChannelData->AdvanceToNextEdge();
-		const auto risingEdge = mChannelData->GetSampleNumber();
-
-		const auto lowPulseLength = risingEdge - fallingEdge;
-		const auto centerOfLowPulse = fallingEdge + lowPulseLength / 2;
-		const auto expectedNextLowEdge = risingEdge + samplesPerTick * Waveform::high;
+	}
+}
 
-		const auto waveform = Waveform{matchSamplesToTicks(samplesPerTick, lowPulseLength)};
-		auto maybeBitType = getBitFromWaveform(waveform);
-		if (!maybeBitType.has_value())
+TickLength HKWireAnalyzer::detectTickLength(const U64& fallingEdge, std::vector<U64>& edges)
+{
+	// Collects the first pulses as falling, rising, ..., falling edge.
+	// Stops early at the rising edge before the bus goes quiet after a transmission,
+	// measured in the longest low pulse so far (a start bit, hopefully).
+	std::vector<U64> lowPulses;
+	U64 longestLow = 0;
+	edges.push_back( fallingEdge );
+	while (lowPulses.size() < TimeBase::detectionPulses)
+	{
+		// not through the glitch filter yet, it would wait for the next transmission
+		const auto risingEdge = takeEdge();
+		const U64 lowPulse = risingEdge - edges.back();
+		const U64 quiet = std::max( longestLow, lowPulse ) * 2;
+		// that long without an edge is no glitch either
+		const bool idle = lowPulses.size() + 1 >= TimeBase::minDetectionPulses &&
+		                  !mChannelData->WouldAdvancingCauseTransition( U32(std::min<U64>(quiet, 0xFFFFFFFF)) );
+		if (!idle && isGlitch( risingEdge ))
 		{
-			// Üeh
-			mResults->AddMarker(centerOfLowPulse,
-								AnalyzerResults::ErrorDot,
-								mSettings->mDataChannel );
-
-			// nothing good will come from this.
-			mResults->CancelPacketAndStartNewPacket();
-			state.reset();
 			continue;
 		}
-		auto& bitType = *maybeBitType;
-
-		// // this does not work, because it advances the mResults time pointer too far
-		// for(Ticks i=0; i < waveform.low; i++ )
-		// {
-		// 	//let's put a dot for every tick counter (just cosmetics)
-		// 	mResults->AddMarker(fallingEdge + i * samplesPerTick,
-		// 					    AnalyzerResults::Dot,
-		// 						mSettings->mDataChannel);
-		// }
-
-		// check duration of stop (high) pulse
-		// end byte only differs by high-duration.
-		// This is observed to be about 8ms, or just one Tick if busy.
-		// Could be checked by "busy" line,
-		// but this is not necessary (just greater than 2 ticks or equal to one tick)
-		// or implied through the number of observed bits (TODO)
-		const auto samplingOffset = samplesPerTick / 2;
-		const auto oneTick  = samplesPerTick;
-		const auto twoTicks = samplesPerTick * 2;
-		const auto isShortHigh = mChannelData->WouldAdvancingCauseTransition(oneTick + samplingOffset);
-		const auto isLongHigh = !mChannelData->WouldAdvancingCauseTransition(twoTicks + samplingOffset);
-		if (isShortHigh || isLongHigh)
+		lowPulses.push_back( lowPulse );
+		longestLow = std::max( longestLow, lowPulse );
+		edges.push_back( risingEdge );
+		if (idle)
 		{
-			// this is an end bit
-			bitType = BitType::end;
+			if (const auto detected = TimeBase::detectTickLength( lowPulses ))
+			{
+				return *detected;
+			}
 		}
+		edges.push_back( advanceToNextEdge() );
+	}
+	// no luck, hope for the best
+	return TimeBase::detectTickLength( lowPulses )
+	       .value_or( TickLength::fromTimeBase(HKWireAnalyzerSettings::defaultTimeBase_us, GetSampleRate()) );
+}
+
+void HKWireAnalyzer::WorkerThread()
+{
+	const auto sampleRateHz = GetSampleRate();
+	mChannelData = GetAnalyzerChannelData( mSettings->mDataChannel );
+	// the configured tick, glitches do not need to be measured precisely
+	mMinLevel_samples = U32( getSamplesPerTick( mSettings->getNominalTimeBase_us(), sampleRateHz ) *
+	                         mSettings->mGlitchFilter_percent / 100 );
+	mNumSuppressedGlitches = 0;
+	mNumSuppressedGlitchesReported = 0;
+	mBusyData = nullptr;
+	mInTransmission = false;
+	if (mSettings->hasBusyChannel())
+	{
+		mBusyData = GetAnalyzerChannelData( mSettings->mOptionalBusyChannel );
+		mBusyHeld = mBusyData->GetBitState() == BIT_LOW;
+		mBusyFreeSince = mBusyData->GetSampleNumber();
+	}
+
+	// We look for transitions from HIGH to LOW, so sync to the first falling edge
+	mHasHeldEdge = false;
+	mDataLow = mChannelData->GetBitState() == BIT_LOW;
+	U64 fallingEdge;
+	do
+	{
+		fallingEdge = advanceToNextEdge();
+	}
+	while( !mDataLow );
+
+	// the pulses looked at for detection are decoded afterwards
+	std::vector<U64> detectionEdges;
+	TickLength tickLength;
+	if (mSettings->mTimeBase_us == HKWireAnalyzerSettings::autoTimeBase)
+	{
+		tickLength = detectTickLength( fallingEdge, detectionEdges );
+	}
+	else
+	{
+		tickLength = TickLength::fromTimeBase(mSettings->mTimeBase_us, sampleRateHz);
+	}
+	mTickLength = tickLength;
+	mSamplesPerTick = tickLength.getSamples();
+
+	Decoder decoder(*this, tickLength, mSettings->getPulseTolerance());
+	// answers come within a second, if at all
+	mTransactions.reset( new TransactionMatcher( sampleRateHz ) );
+	mResults->StartStatistics( sampleRateHz );
+
+	for (size_t i = 0; i + 2 < detectionEdges.size(); i += 2)
+	{
+		decoder.pulse(detectionEdges[i], detectionEdges[i + 1],
+		              decoder.classifyHighTime(detectionEdges[i + 2] - detectionEdges[i + 1]));
+	}
+	if (!detectionEdges.empty())
+	{
+		fallingEdge = detectionEdges.back();
+	}
+	if (detectionEdges.size() % 2 == 0 && !detectionEdges.empty())
+	{
+		// detection stopped at the end of a transmission
+		decoder.pulse(detectionEdges[detectionEdges.size() - 2], detectionEdges.back(), HighTime::idleEnd);
+		fallingEdge = advanceToNextEdge();
+	}
 
-		if (state.currentNumberOfBitsReceived == 0)
+	// The falling edge after a pulse gives its high time, no need to look ahead.
+	// Only after a possible end bit the bus may go idle, and we don't want to
+	// wait for the next transmission to show the last one.
+	// The rising edge goes through the glitch filter only after that, so nothing
+	// is fetched ahead of it while the bus might be idle.
+	for( ; ; )
+	{
+		const auto risingEdge = takeEdge();
+
+		const auto endHighTime = decoder.mayBeEndBit(risingEdge - fallingEdge)
+		                         ? getEndOfTransmission(decoder, risingEdge) : std::nullopt;
+		if (endHighTime.has_value())
+		{
+			decoder.pulse(fallingEdge, risingEdge, *endHighTime);
+			fallingEdge = advanceToNextEdge();
+			continue;
+		}
+		if (isGlitch( risingEdge ))
 		{
-			// could have been estimated in the transition, but this is cleaner.
-			state.startOfCurrentWord = fallingEdge;
+			// still the same low
+			continue;
 		}
 
-		// now let's reason about this bit.
-		AnalyzerResults::MarkerType markerType;
-		switch (bitType)
+		const auto nextFallingEdge = advanceToNextEdge();
+		decoder.pulse(fallingEdge, risingEdge, decoder.classifyHighTime(nextFallingEdge - risingEdge));
+		fallingEdge = nextFallingEdge;
+	}
+}
+
+std::optional<HighTime>
+HKWireAnalyzer::getEndOfTransmission(const Decoder& decoder, const U64& risingEdge)
+{
+	if (mBusyData != nullptr && mBusyHeldAtStart)
+	{
+		// the sender lets go of BUSY with its end bit, give it half a tick
+		followBusy( risingEdge + mSamplesPerTick / 2 );
+		// unless the end bit was a glitch, DATA has not been filtered here
+		if (!mBusyHeld &&
+		    (mMinLevel_samples == 0 || !mChannelData->WouldAdvancingCauseTransition( mMinLevel_samples - 1 )))
 		{
-			case BitType::start:
-				// start state.
-				state = HKWireState(fallingEdge);
-				markerType = AnalyzerResults::Start;
-				mResults->CommitPacketAndStartNewPacket(); // probably useless anyway
-				break;
-			case BitType::data1:
-				state.setCurrentBit(1);
-				markerType = AnalyzerResults::One;
-				break;
-			case BitType::data0:
-				state.setCurrentBit(0);
-				markerType = AnalyzerResults::Zero;
-				break;
-			case BitType::end:
-				markerType = isShortHigh ? AnalyzerResults::Dot : AnalyzerResults::Stop;
-				// this could indicate the actual state, but
-				// knowledge about whether we had data is
-				// easier to keep with the state than an extra bool
-				// state.consumeBit(bitType);
-				break;
-			default:
-				cerr << "Üeh, unknown bit type! (" << to_underlying(bitType) <<
-						")" << endl;
-				markerType = AnalyzerResults::ErrorX;
+			// BUSY only says where it ends, the high after it still tells whether
+			// the next transmission follows right away
+			return mChannelData->WouldAdvancingCauseTransition(U32(decoder.getBusyEndThreshold()))
+			       ? HighTime::busyEnd : HighTime::idleEnd;
 		}
-		state.currentNumberOfBitsReceived++;
-		mResults->AddMarker(centerOfLowPulse, markerType, mSettings->mDataChannel);
+		// kept for the next transmission, or released late
+	}
+	// the idle threshold is longer than any glitch, so this also passes the glitch filter
+	if (!mChannelData->WouldAdvancingCauseTransition(U32(decoder.getIdleThreshold())))
+	{
+		return HighTime::idleEnd;
+	}
+	return std::nullopt;
+}
 
-		// check for transition
-		const auto canAdvanceState = state.canAdvanceState(bitType);
-		if (! canAdvanceState.has_value())
+void
+HKWireAnalyzer::followBusy(const U64& sample)
+{
+	while (mBusyData->WouldAdvancingToAbsPositionCauseTransition( sample ))
+	{
+		mBusyData->AdvanceToNextEdge();
+		const U64 edge = mBusyData->GetSampleNumber();
+		if (mBusyData->GetBitState() == BIT_LOW)
 		{
-			cerr << "We over-stated our state (" << to_underlying(state.wordState) <<
-						")" << endl;
-			mResults->AddMarker(centerOfLowPulse,
-					AnalyzerResults::ErrorSquare,
-					mSettings->mDataChannel);
-			// PS.: It is ok that we already wrote into something,
-			// we have a buffer of one byte (because of ::_num)
-			mResults->CancelPacketAndStartNewPacket();
+			mBusyHeld = true;
+			mBusyFreeSince = edge;
 			continue;
 		}
-		if (canAdvanceState.value())
+		if (mBusyHeld && !mInTransmission && mBusyFreeSince < edge)
 		{
-			// in word level, we don't care about the actual state
-			const bool wordlevelProduceFrame =
-					(mSettings->mDecodeLevel == HKWireAnalyzerSettings::wordlevel) &&
-					// don't want to produce end frame info here
-					hasWordStateData(state.wordState) && bitType != BitType::end;
+			addBusyFrame( mBusyFreeSince, edge - 1 );
+		}
+		mBusyHeld = false;
+	}
+}
+
+void
+HKWireAnalyzer::addBusyFrame(const U64& start, const U64& end)
+{
+	Frame frame;
+	frame.mStartingSampleInclusive = start;
+	frame.mEndingSampleInclusive = end;
+	frame.mData1 = 0;
+	frame.mData2 = 0;
+	frame.mType = HKWireAnalyzerResults::busyFrame;
+	frame.mFlags = 0;
+	mResults->AddFrame( frame );
 
-			const bool commandLevelProduceFrame =
-					mSettings->isCommandLevel() &&
-					(bitType == BitType::end);
+	FrameV2 frame_v2;
+	frame_v2.AddDouble("duration [ms]", (end - start + 1) * 1000.0 / GetSampleRate());
+	mResults->AddFrameV2( frame_v2, "bus held", start, end );
+}
 
-			if (wordlevelProduceFrame || commandLevelProduceFrame)
+void
+HKWireAnalyzer::onMarker(const U64& sample, const HKWire::Marker& marker, const HKWire::HKWireState& state)
+{
+	if (mBusyData != nullptr)
+	{
+		if (marker == Marker::start)
+		{
+			// whatever BUSY did up to here belongs before this transmission
+			followBusy( state.startOfTransmission );
+			if (mBusyHeld && mBusyFreeSince < state.startOfTransmission)
 			{
-				//print out a Frame
-				const auto& endOfFrame = risingEdge + oneTick;
-				addFrame(state, endOfFrame);
-				ReportProgress( endOfFrame );
+				addBusyFrame( mBusyFreeSince, state.startOfTransmission - 1 );
 			}
+			mInTransmission = true;
+			mBusyHeldAtStart = mBusyHeld;
+		}
+		else if (marker == Marker::invalidPulse || marker == Marker::invalidState)
+		{
+			// the rest of it is skipped, see onLost
+			mBusyHeldAtStart = false;
+		}
+	}
 
-			// advance
-			state.advanceState();
+	AnalyzerResults::MarkerType markerType;
+	switch (marker)
+	{
+		case Marker::start:
+			markerType = AnalyzerResults::Start;
+			break;
+		case Marker::data1:
+			markerType = AnalyzerResults::One;
+			break;
+		case Marker::data0:
+			markerType = AnalyzerResults::Zero;
+			break;
+		case Marker::busyEnd:
+			markerType = AnalyzerResults::Dot;
+			break;
+		case Marker::idleEnd:
+			markerType = AnalyzerResults::Stop;
+			break;
+		case Marker::invalidPulse:
+			markerType = AnalyzerResults::ErrorDot;
+			break;
+		case Marker::invalidState:
+			markerType = AnalyzerResults::ErrorSquare;
+			break;
+		default:
+			markerType = AnalyzerResults::ErrorX;
+	}
 
-			// commit markers and maybe frame
-			mResults->CommitResults();
-		}
+	const bool isError = marker == Marker::invalidPulse || marker == Marker::invalidState;
+	if (isError)
+	{
+		const auto kind = marker == Marker::invalidPulse ? DiagnosticKind::invalidPulse : DiagnosticKind::invalidState;
+		mResults->GetDiagnostics().push( Diagnostic{sample, kind, state.wordState} );
+		mResults->UpdateStatistics( [&]( BusStatistics& statistics ) { statistics.addError( kind, state.wordState ); } );
+	}
+	switch (mSettings->mMarkerDensity)
+	{
+		case HKWireAnalyzerSettings::allMarkers:
+			addMarker(sample, markerType);
+			break;
+		case HKWireAnalyzerSettings::errorMarkers:
+			if (marker == Marker::start)
+			{
+				mNumPendingMarkers = 0;
+			}
+			if (isError)
+			{
+				// show what lead to this
+				for (size_t i = 0; i < mNumPendingMarkers; i++)
+				{
+					addMarker(mPendingMarkers[i].sample, mPendingMarkers[i].type);
+				}
+				mNumPendingMarkers = 0;
+				addMarker(sample, markerType);
+			}
+			else if (mNumPendingMarkers < mPendingMarkers.size())
+			{
+				mPendingMarkers[mNumPendingMarkers++] = PendingMarker{sample, markerType};
+			}
+			break;
+		default:
+			// error markers are always kept
+			if (isError)
+			{
+				addMarker(sample, markerType);
+			}
+	}
 
+	if (isError)
+	{
+		// nothing good will come from this.
+		mResults->CancelPacketAndStartNewPacket();
 	}
 }
 
 void
-HKWireAnalyzer::addFrame(const HKWire::HKWireState& state, const U32& endOfTransmission)
+HKWireAnalyzer::onLost(const U64& start, const U64& end)
 {
-	if (mSettings->mDecodeLevel == HKWireAnalyzerSettings::wordlevel)
-	{
-		addWordFrame(state, endOfTransmission);
-	}
-	else if (mSettings->isCommandLevel())
+	if (mBusyData != nullptr)
 	{
-		addCommandFrame(state, endOfTransmission);
+		// same as for a start bit, if the broken one had none
+		followBusy( start );
+		if (!mInTransmission && mBusyHeld && mBusyFreeSince < start)
+		{
+			addBusyFrame( mBusyFreeSince, start - 1 );
+		}
+		mInTransmission = false;
+		mBusyFreeSince = end + 1;
 	}
-	// no commit, because this is done somewhere else
+
+	Frame frame;
+	frame.mStartingSampleInclusive = start;
+	frame.mEndingSampleInclusive = end;
+	frame.mData1 = 0;
+	frame.mData2 = 0;
+	frame.mType = HKWireAnalyzerResults::lostFrame;
+	frame.mFlags = DISPLAY_AS_ERROR_FLAG;
+	mResults->AddFrame( frame );
+
+	FrameV2 frame_v2;
+	// up to the rising edge, like Decoder::getLostSamples
+	frame_v2.AddDouble("duration [ms]", (end - start) * 1000.0 / GetSampleRate());
+	mResults->AddFrameV2( frame_v2, "lost", start, end );
+	mResults->GetDiagnostics().push( Diagnostic{start, DiagnosticKind::lost, WordState::_num} );
+	mResults->UpdateStatistics( [&]( BusStatistics& statistics ) { statistics.addLost( start, end ); } );
+	mResults->CommitResults();
+	ReportProgress( end );
 }
 
 void
-HKWireAnalyzer::addWordFrame(const HKWire::HKWireState& state, const U32& endOfTransmission)
+HKWireAnalyzer::addMarker(const U64& sample, const AnalyzerResults::MarkerType& type)
 {
-	// inspired by one-wire: just generate both v1 and v2 frames, lolo
+	mResults->AddMarker(sample, type, mSettings->mDataChannel);
+}
 
-	Frame frame;		// needed for bubble text
-	frame.mStartingSampleInclusive = state.startOfCurrentWord;
-	frame.mEndingSampleInclusive = endOfTransmission;
-	frame.mData1 = state.payload.getSerialized();
-	//frame.mData2 = some_more_data_we_collected;
-	frame.mType = to_underlying(state.wordState);
-	frame.mFlags = mSettings->mDecodeLevel;
-	mResults->AddFrame( frame );
+void
+HKWireAnalyzer::onCommand(const HKWire::CommandRecord& record)
+{
+	// decode level is only a matter of presentation,
+	// everything is derived from the record in the frames.
+	addCommandFrame(record);
+	// its bit markers are of no use to the next error
+	mNumPendingMarkers = 0;
+	mResults->UpdateStatistics( [&]( BusStatistics& statistics ) { statistics.addCommand( record ); } );
+	ReportProgress( record.end );
+}
 
-	FrameV2 frame_v2;	// nice for table
-	const char* type = getNameOfWordState(state.wordState);
-	const auto wordWidth = getBitsPerWord(state.wordState).value_or(8);
-	if (wordWidth <= 8)
-	{
-		frame_v2.AddByte(type, state.payload.getWord(state.wordState));
-	}
-	else
-	{
-		// probably dead code with data now split in two phases
-		const auto hoData = state.payload.getDataInHostOrder(); // ??
-		frame_v2.AddByteArray(type, reinterpret_cast<const U8*>(&hoData), sizeof(decltype(hoData)));
-	}
-	mResults->AddFrameV2( frame_v2, type, state.startOfCurrentWord, endOfTransmission );
-	// no commit, because this is done somewhere else
+void
+HKWireAnalyzer::onAdvance(const HKWire::HKWireState& /* state */)
+{
+	// commit markers and maybe frame
+	mResults->CommitResults();
 }
 
 void
-HKWireAnalyzer::addCommandFrame(const HKWire::HKWireState& state, const U32& endOfTransmission)
+HKWireAnalyzer::addCommandFrame(const HKWire::CommandRecord& record)
 {
 	// inspired by one-wire: just generate both v1 and v2 frames, lolo
-	Frame frame;		// needed for bubble text
-	frame.mStartingSampleInclusive = state.startOfTransmission;
-	frame.mEndingSampleInclusive = endOfTransmission;
-	frame.mData1 = state.payload.getSerialized();
-	//frame.mData2 = some_more_data_we_collected;
-	frame.mType = to_underlying(state.wordState);
-	frame.mFlags = mSettings->mDecodeLevel;
-	mResults->AddFrame( frame );
+	const auto& payload = record.payload;
 
-	const bool tryDecode = mSettings->mDecodeLevel == HKWireAnalyzerSettings::textlevel;
+	Frame frame;		// needed for bubble text
+	frame.mStartingSampleInclusive = record.start;
+	frame.mEndingSampleInclusive = record.end;
+	frame.mData1 = payload.getSerialized();
+	frame.mData2 = record.getPackedWordOffsets();
+	frame.mType = HKWireAnalyzerResults::commandFrame;
+	frame.mFlags = 0;
+	if (mSettings->mDecodeLevel == HKWireAnalyzerSettings::wordlevel)
+	{
+		// A bubble per word needs a frame per word. Each carries the whole command,
+		// the last one ends with it, see HKWireAnalyzerResults::GetRecord().
+		const auto lastWord = payload.getLastWord();
+		for (auto word = WordState::source; word <= lastWord;
+		     word = static_cast<WordState>(std::to_underlying(word) + 1))
+		{
+			frame.mStartingSampleInclusive = record.getStartOfWord( word, mTickLength );
+			frame.mEndingSampleInclusive = word == lastWord ? record.end : record.getEndOfWord( word, mTickLength );
+			frame.mType = std::to_underlying( word );
+			mResults->AddFrame( frame );
+		}
+	}
+	else
+	{
+		mResults->AddFrame( frame );
+	}
+	// one packet per command, transactions are made from those
+	const U64 packet = mResults->CommitPacketAndStartNewPacket();
+	const auto answered = mTransactions->onCommand(record, packet);
 
+	// The table can't change without a rerun, so it gets the numbers
+	// and, where we know them, the names.
 	FrameV2 frame_v2;	// nice for table
 	const char* type = "command";
 
-	const ID src = state.payload.getWord(WordState::source);
-	const ID dst = state.payload.getWord(WordState::dest);
-	const Command cmd = state.payload.getWord(WordState::command);
+	const ID src = payload.getWord(WordState::source);
+	const ID dst = payload.getWord(WordState::dest);
+	const Command cmd = payload.getWord(WordState::command);
 
+	frame_v2.AddByte(getNameOfWordState(WordState::source), src);
+	frame_v2.AddByte(getNameOfWordState(WordState::dest), dst);
+	frame_v2.AddByte(getNameOfWordState(WordState::command), cmd);
 
-	const auto maybeSrcName = knownIDs.find(src);
-	const auto maybeDstName = knownIDs.find(dst);
-	const auto maybeCommandDescriptionMap = knownCommands.find(dst);
-	std::optional<const char*> maybeCommandName;
-	if (maybeCommandDescriptionMap != knownCommands.cend())
+	// "reverse" test
+	if (payload.data2.has_value())
 	{
-		if (maybeCommandDescriptionMap->second.find(cmd) != maybeCommandDescriptionMap->second.cend())
-		{
-			// Uffuff
-			maybeCommandName = maybeCommandDescriptionMap->second.find(cmd)->second;
-		}
+		type = "command with 16 bit data";
+		U8 arrayData[2];
+		arrayData[0] = *payload.data1;	// zero is leftmost
+		arrayData[1] = *payload.data2;
+		frame_v2.AddByteArray("data", arrayData, sizeof(arrayData));
 	}
-
-	// TODO: Make this less redundant
-	if (tryDecode && maybeSrcName != knownIDs.cend())
+	else if (payload.data1.has_value())
 	{
-		frame_v2.AddString(getNameOfWordState(WordState::source), maybeSrcName->second);
+		type = "command with 8 bit data";
+		frame_v2.AddByte("data", payload.getDataInHostOrder());
 	}
-	else
+
+	if (const auto name = getNameOfID(src))
 	{
-		frame_v2.AddByte(getNameOfWordState(WordState::source), state.payload.getWord(WordState::source));
+		frame_v2.AddString("source name", *name);
 	}
-	if (tryDecode && maybeDstName != knownIDs.cend())
+	if (const auto name = getNameOfID(dst))
 	{
-		frame_v2.AddString(getNameOfWordState(WordState::dest), maybeDstName->second);
+		frame_v2.AddString("destination name", *name);
 	}
-	else
+	if (const auto name = getNameOfCommand(dst, cmd))
 	{
-		frame_v2.AddByte(getNameOfWordState(WordState::dest), state.payload.getWord(WordState::dest));
+		frame_v2.AddString("command name", *name);
 	}
-	if (tryDecode && maybeCommandName.has_value())
+	char decoded[32];
+	if (decodeData(payload, decoded, sizeof(decoded)))
 	{
-		frame_v2.AddString(getNameOfWordState(WordState::command), *maybeCommandName);
+		frame_v2.AddString("decoded data", decoded);
 	}
-	else
+	if (mNumSuppressedGlitches > mNumSuppressedGlitchesReported)
 	{
-		frame_v2.AddByte(getNameOfWordState(WordState::command), state.payload.getWord(WordState::command));
+		// since the command before
+		frame_v2.AddInteger("suppressed glitches", S64(mNumSuppressedGlitches - mNumSuppressedGlitchesReported));
+		mNumSuppressedGlitchesReported = mNumSuppressedGlitches;
 	}
-
-	// "reverse" test
-	if (state.payload.data2.has_value())
+	if (answered.has_value())
 	{
-		type = "command with 16 bit data";
-		U8 arrayData[2];
-		arrayData[0] = *state.payload.data1;	// zero is leftmost
-		arrayData[1] = *state.payload.data2;
-		frame_v2.AddByteArray("data", arrayData, sizeof(arrayData));
+		frame_v2.AddByte("answers", answered->request);
+		frame_v2.AddDouble("response time [ms]", (record.start - answered->requestStart) * 1000.0 / GetSampleRate());
 	}
-	else if (state.payload.data1.has_value())
+	mResults->AddFrameV2( frame_v2, type, record.start, record.end );
+
+	if (answered.has_value())
 	{
-		type = "command with 8 bit data";
-		frame_v2.AddByte("data", state.payload.getDataInHostOrder());
+		// a request is answered only once, so its packet makes a fine id
+		const U64 transaction = answered->requestTag;
+		mResults->AddPacketToTransaction( transaction, answered->requestTag );
+		mResults->AddPacketToTransaction( transaction, packet );
 	}
-	mResults->AddFrameV2( frame_v2, type, state.startOfTransmission, endOfTransmission );
 
-	// debugging
-	if (state.startOfTransmission == 0)
+	if (mBusyData != nullptr)
 	{
-		cerr << "Is something fishy?" << endl;
+		mInTransmission = false;
+		mBusyHeldAtStart = false;
+		mBusyFreeSince = record.end + 1;
 	}
 
 	// no commit, because this is done somewhere else
@@ -319,12 +570,18 @@ bool HKWireAnalyzer::NeedsRerun()
 
 U32 HKWireAnalyzer::GenerateSimulationData( U64 minimum_sample_index, U32 device_sample_rate, SimulationChannelDescriptor** simulation_channels )
 {
-	return 0;
+	if( mSimulationInitilized == false )
+	{
+		mSimulationDataGenerator.Initialize( GetSimulationSampleRate(), mSettings.get() );
+		mSimulationInitilized = true;
+	}
+
+	return mSimulationDataGenerator.GenerateSimulationData( minimum_sample_index, device_sample_rate, simulation_channels );
 }
 
 U32 HKWireAnalyzer::GetMinimumSampleRateHz()
 {
-	return mSettings->mTimeBase_us * 4;
+	return mSettings->getNominalTimeBase_us() * 4;
 }
 
 const char* HKWireAnalyzer::GetAnalyzerName() const
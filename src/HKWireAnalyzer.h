@@ -3,10 +3,15 @@
 
 #include <Analyzer.h>
 #include "HKWire.h"
+#include "HKWireDecoder.h"
+#include "HKWireTransactions.h"
 #include "HKWireAnalyzerResults.h"
+#include "HKWireSimulationDataGenerator.h"
+
+#include <vector>
 
 class HKWireAnalyzerSettings;
-class ANALYZER_EXPORT HKWireAnalyzer : public Analyzer2
+class ANALYZER_EXPORT HKWireAnalyzer : public Analyzer2, private HKWire::DecoderListener
 {
 
 
@@ -23,19 +28,84 @@ public:
 	virtual const char* GetAnalyzerName() const;
 	virtual bool NeedsRerun();
 
+	// as configured or detected, valid once the first frames are there
+	HKWire::TickLength GetTickLength() const;
+
 protected: //vars
 	std::unique_ptr< HKWireAnalyzerSettings > mSettings;
 	std::unique_ptr< HKWireAnalyzerResults > mResults;
 	AnalyzerChannelData* mChannelData;
+	HKWire::TickLength mTickLength;
+	U64 mSamplesPerTick;	// rounded
+
+	// levels shorter than this are dropped, see isGlitch()
+	U32 mMinLevel_samples;
+	// DATA is one edge ahead of the decoding after a level was checked
+	bool mHasHeldEdge;
+	U64 mHeldEdge;
+	bool mDataLow;	// after the last edge taken
+	U64 mNumSuppressedGlitches;
+	U64 mNumSuppressedGlitchesReported;	// with a command frame
+
+	// BUSY is followed up to where DATA is decoded, and ends transmissions if connected.
+	AnalyzerChannelData* mBusyData;	// nullptr without busy channel
+	bool mBusyHeld;
+	U64 mBusyFreeSince;	// BUSY held, but no command on DATA from here
+	bool mInTransmission;	// or what is left of it after an error
+	bool mBusyHeldAtStart;	// only then its release tells anything
+	std::unique_ptr< HKWire::TransactionMatcher > mTransactions;
+
+	// bit markers of the current transmission, held back until an error shows up
+	struct PendingMarker
+	{
+		U64 sample;
+		AnalyzerResults::MarkerType type;
+	};
+	std::array< PendingMarker, HKWire::getMaxBitsPerTransmission() > mPendingMarkers;
+	size_t mNumPendingMarkers;
+
+	HKWireSimulationDataGenerator mSimulationDataGenerator;
+	bool mSimulationInitilized;
 
 private:
-	// simple dispatcher to Word or command frame functions
+	// HKWire::DecoderListener
+	void
+	onMarker(const U64& sample, const HKWire::Marker& marker, const HKWire::HKWireState& state) override;
+	void
+	onCommand(const HKWire::CommandRecord& record) override;
 	void
-	addFrame(const HKWire::HKWireState& state, const U32& endOfTransmission);
+	onAdvance(const HKWire::HKWireState& state) override;
 	void
-	addWordFrame(const HKWire::HKWireState& state, const U32& endOfTransmission);
+	onLost(const U64& start, const U64& end) override;
+
+	HKWire::TickLength
+	detectTickLength(const U64& fallingEdge, std::vector<U64>& edges);
+
+	// next edge of DATA, not checked for glitches yet
+	U64
+	takeEdge();
+	// Whether the level from the `edge` just taken on is shorter than mMinLevel_samples.
+	// Fetches the edge after it, which is dropped along with `edge` or held for takeEdge().
+	bool
+	isGlitch(const U64& edge);
+	// of DATA, through the glitch filter
+	U64
+	advanceToNextEdge();
+
+	void
+	addMarker(const U64& sample, const AnalyzerResults::MarkerType& type);
+
+	void
+	followBusy(const U64& sample);
+	// After a possible end bit, the high time that ends the transmission there, if it does.
+	// Without waiting for the idle line if BUSY says so.
+	std::optional<HKWire::HighTime>
+	getEndOfTransmission(const HKWire::Decoder& decoder, const U64& risingEdge);
+	void
+	addBusyFrame(const U64& start, const U64& end);
+
 	void
-	addCommandFrame(const HKWire::HKWireState& state, const U32& endOfTransmission);
+	addCommandFrame(const HKWire::CommandRecord& record);
 
 };
 
@@ -3,16 +3,18 @@
 #include "HKWireAnalyzer.h"
 #include "HKWireAnalyzerSettings.h"
 #include "HKWire.h"
+#include "HKWireBinaryExport.h"
+#include "HKWirePcapExport.h"
 
-#include <iostream>
-#include <fstream>
+#include <cstdio>
 
 using namespace HKWire;
 
 HKWireAnalyzerResults::HKWireAnalyzerResults( HKWireAnalyzer* analyzer, HKWireAnalyzerSettings* settings )
 :	AnalyzerResults(),
 	mSettings( settings ),
-	mAnalyzer( analyzer )
+	mAnalyzer( analyzer ),
+	mNumUnloggedDiagnostics( 0 )
 {
 }
 
@@ -20,135 +22,380 @@ HKWireAnalyzerResults::~HKWireAnalyzerResults()
 {
 }
 
-void HKWireAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel, DisplayBase display_base )
+bool HKWireAnalyzerResults::IsCommandFrame( const Frame& frame ) const
 {
-	ClearResultStrings();
-	Frame frame = GetFrame( frame_index );
-	const auto& state = static_cast<WordState>(frame.mType);
-	const char* type = getNameOfWordState(state);
-	const auto decodeLevel = static_cast<HKWireAnalyzerSettings::DecodeLevel>(frame.mFlags);
+	if (frame.mType == commandFrame)
+	{
+		return true;
+	}
+	// the frame of the last word ends with the command
+	const auto word = static_cast<WordState>( frame.mType );
+	return hasWordStateData( word ) && word == Payload( frame.mData1 ).getLastWord();
+}
+
+HKWire::CommandRecord HKWireAnalyzerResults::GetRecord( const Frame& frame ) const
+{
+	CommandRecord record{U64(frame.mStartingSampleInclusive), U64(frame.mEndingSampleInclusive),
+	                     Payload(frame.mData1), CommandRecord::unpackWordOffsets(frame.mData2)};
+	if (frame.mType != commandFrame)
+	{
+		// same rounding as where the analyzer placed the word
+		record.start -= record.getOffsetOfWord( static_cast<WordState>( frame.mType ), GetTickLength() );
+	}
+	return record;
+}
+
+HKWireAnalyzerResults::Diagnostics& HKWireAnalyzerResults::GetDiagnostics()
+{
+	return mDiagnostics;
+}
 
-	if (decodeLevel == HKWireAnalyzerSettings::wordlevel)
+void HKWireAnalyzerResults::DrainDiagnostics()
+{
+	// two at once would both be consumers
+	std::lock_guard< std::mutex > lock( mDrainMutex );
+	mDiagnostics.drain( [&]( const Diagnostic& diagnostic )
 	{
-		if (hasWordStateData(state))
+		if (mDrainedDiagnostics.size() < maxLoggedDiagnostics)
 		{
-			char number_str[128];
-			const auto numBits = getBitsPerWord(state).value_or(8);
-			const auto payload = Payload(frame.mData1);
-			const auto data = payload.getWord(state);
-			AnalyzerHelpers::GetNumberString( data, display_base, numBits, number_str, 128 );
-			AddResultString( number_str );
-			AddResultString( type, " ", number_str );
+			mDrainedDiagnostics.push_back( diagnostic );
 		}
 		else
 		{
-			AddResultString( type );
+			mNumUnloggedDiagnostics++;
 		}
-	}
-	else
-	{
-		// whole command
-		char src[16];
-		char dst[16];
-		char cmd[16];
-		char data[16] = {0};	// default: none
-		const auto payload = Payload(frame.mData1);
+	} );
+}
+
+void HKWireAnalyzerResults::StartStatistics( U64 sample_rate )
+{
+	std::lock_guard< std::mutex > lock( mStatisticsMutex );
+	mStatistics.reset( new BusStatistics( sample_rate ) );
+}
+
+HKWire::TickLength HKWireAnalyzerResults::GetTickLength() const
+{
+	// might have been detected
+	return mAnalyzer->GetTickLength();
+}
 
-		AnalyzerHelpers::GetNumberString( payload.source, display_base, *getBitsPerWord(WordState::source), src, 16 );
-		AnalyzerHelpers::GetNumberString( payload.dest, display_base, *getBitsPerWord(WordState::dest), dst, 16 );
-		AnalyzerHelpers::GetNumberString( payload.command, display_base, *getBitsPerWord(WordState::command), cmd, 16 );
-		if (payload.data1.has_value())
+void HKWireAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel, DisplayBase display_base )
+{
+	ClearResultStrings();
+	Frame frame = GetFrame( frame_index );
+	if (frame.mType == busyFrame)
+	{
+		if (channel == mSettings->mOptionalBusyChannel)
 		{
-			// ugly as fuck, for separation
-			data[0] = ' ';
-			const auto length = payload.getDataLength();	// might also have data2
-			AnalyzerHelpers::GetNumberString( payload.getDataInHostOrder(), display_base, length, data + 1, 16 );
+			GenerateBusyBubbleText( frame, display_base );
 		}
-		// TODO: Decode source, dest, and cmd
-		AddResultString(src, " -> ", dst, " : ", cmd, data);
+		return;
+	}
+	if (channel != mSettings->mDataChannel)
+	{
+		return;
 	}
+	if (frame.mType == lostFrame)
+	{
+		GenerateLostBubbleText( frame, display_base );
+		return;
+	}
+	if (frame.mType != commandFrame)
+	{
+		GenerateWordBubbleText( frame, display_base );
+		return;
+	}
+	const auto payload = Payload(frame.mData1);
+	const auto command = FormatCommand( payload, display_base );
+
+	// shortest first, Logic picks the longest that fits
+	AddResultString( command.cmd );
+
+	// command and text level are views of the same frame
+	char text[256];
+	switch (mSettings->mDecodeLevel)
+	{
+	case HKWireAnalyzerSettings::textlevel:
+	{
+		AddResultString( command.line );
+		// e.g. "-01:59" instead of the raw BCD
+		char decoded[32];
+		const bool isDecoded = decodeData(payload, decoded, sizeof(decoded));
+		snprintf( text, sizeof(text), "%s -> %s : %s%s%s",
+		          getNameOfID(payload.source).value_or(command.src),
+		          getNameOfID(payload.dest).value_or(command.dst),
+		          getNameOfCommand(payload.dest, payload.command).value_or(command.cmd),
+		          isDecoded ? " " : "", isDecoded ? decoded : command.data );
+		AddResultString( text );
+		break;
+	}
+	default:
+		AddResultString( command.line );
+	}
+}
 
+HKWireAnalyzerResults::CommandText HKWireAnalyzerResults::FormatCommand( const Payload& payload, DisplayBase display_base ) const
+{
+	CommandText text;
+	AnalyzerHelpers::GetNumberString( payload.source, display_base, *getBitsPerWord(WordState::source), text.src, sizeof(text.src) );
+	AnalyzerHelpers::GetNumberString( payload.dest, display_base, *getBitsPerWord(WordState::dest), text.dst, sizeof(text.dst) );
+	AnalyzerHelpers::GetNumberString( payload.command, display_base, *getBitsPerWord(WordState::command), text.cmd, sizeof(text.cmd) );
+	text.data[0] = 0;	// default: none
+	if (payload.data1.has_value())
+	{
+		// ugly as fuck, for separation
+		text.data[0] = ' ';
+		const auto length = payload.getDataLength();	// might also have data2
+		AnalyzerHelpers::GetNumberString( payload.getDataInHostOrder(), display_base, length, text.data + 1, sizeof(text.data) - 1 );
+	}
+	snprintf( text.line, sizeof(text.line), "%s -> %s : %s%s", text.src, text.dst, text.cmd, text.data );
+	return text;
 }
 
-void HKWireAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
+void HKWireAnalyzerResults::GenerateWordBubbleText( const Frame& frame, DisplayBase display_base )
 {
-	std::ofstream file_stream( file, std::ios::out );
+	const auto word = static_cast<WordState>( frame.mType );
+	const auto payload = Payload( frame.mData1 );
+	char number_str[16];
+	AnalyzerHelpers::GetNumberString( payload.getWord( word ), display_base, getBitsPerWord( word ).value_or( 8 ), number_str, 16 );
+	AddResultString( number_str );
+	AddResultString( getNameOfWordState( word ), " ", number_str );
+}
 
-	// just assume from the first frame. Ugly AF
-	const auto decodeLevel = static_cast<HKWireAnalyzerSettings::DecodeLevel>(GetFrame( 0 ).mFlags);
+void HKWireAnalyzerResults::GenerateBusyBubbleText( const Frame& frame, DisplayBase /*display_base*/ )
+{
+	const double duration_ms = ( frame.mEndingSampleInclusive - frame.mStartingSampleInclusive + 1 ) * 1000.0 / mAnalyzer->GetSampleRate();
+	char text[32];
+	snprintf( text, sizeof(text), "held %.1f ms", duration_ms );
+	AddResultString( "held" );
+	AddResultString( text );
+	snprintf( text, sizeof(text), "bus held %.3f ms", duration_ms );
+	AddResultString( text );
+}
 
-	U64 trigger_sample = mAnalyzer->GetTriggerSample();
-	U32 sample_rate = mAnalyzer->GetSampleRate();
+void HKWireAnalyzerResults::GenerateLostBubbleText( const Frame& frame, DisplayBase /*display_base*/ )
+{
+	// the frame ends on the rising edge, which is not lost anymore
+	const double duration_ms = ( frame.mEndingSampleInclusive - frame.mStartingSampleInclusive ) * 1000.0 / mAnalyzer->GetSampleRate();
+	char text[32];
+	snprintf( text, sizeof(text), "lost %.1f ms", duration_ms );
+	AddResultString( "lost" );
+	AddResultString( text );
+	snprintf( text, sizeof(text), "not decoded %.3f ms", duration_ms );
+	AddResultString( text );
+}
 
-	file_stream << "Time [s],Type,";
-	// soo ugly, so much redundancy
-	if (decodeLevel != HKWireAnalyzerSettings::wordlevel)
+namespace
+{
+	void WriteNumber( ExportWriter& writer, U64 number, DisplayBase display_base, U32 num_data_bits )
 	{
-		file_stream << "Src,Dst,Cmd,";
+		switch (display_base)
+		{
+		case Hexadecimal:
+			writer.hex( number, num_data_bits );
+			break;
+		case Decimal:
+			writer.decimal( number );
+			break;
+		default:
+		{
+			// rare enough to not be worth it
+			char number_str[128];
+			AnalyzerHelpers::GetNumberString( number, display_base, num_data_bits, number_str, 128 );
+			writer.text( number_str );
+		}
+		}
 	}
-	file_stream << "Dat" << std::endl;
+}
 
-	U64 num_frames = GetNumFrames();
-	for( U32 i=0; i < num_frames; i++ )
+void HKWireAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
+{
+	ExportWriter writer( file );
+	if (!writer.isOpen())
 	{
-		Frame frame = GetFrame( i );
-		const auto& state = static_cast<WordState>(frame.mType);
-		const auto thisFramesDecodeLevel = static_cast<HKWireAnalyzerSettings::DecodeLevel>(frame.mFlags);
-		if (thisFramesDecodeLevel != decodeLevel)
-			// skip this one. It is different.
-			continue;
+		return;
+	}
+	if (export_type_user_id == HKWireAnalyzerSettings::exportBinary)
+	{
+		GenerateBinaryExportFile( writer );
+		writer.close();
+		return;
+	}
+	if (export_type_user_id == HKWireAnalyzerSettings::exportPcap)
+	{
+		GeneratePcapExportFile( writer );
+		writer.close();
+		return;
+	}
+	if (export_type_user_id == HKWireAnalyzerSettings::exportDiagnostics)
+	{
+		GenerateDiagnosticsExportFile( writer );
+		writer.close();
+		return;
+	}
+	if (export_type_user_id == HKWireAnalyzerSettings::exportStatistics)
+	{
+		GenerateStatisticsExportFile( writer );
+		writer.close();
+		return;
+	}
+
+	// same frames for every level, the export option or the setting decides what to show
+	auto decodeLevel = mSettings->mDecodeLevel;
+	if (export_type_user_id == HKWireAnalyzerSettings::exportWords)
+		decodeLevel = HKWireAnalyzerSettings::wordlevel;
+	else if (export_type_user_id == HKWireAnalyzerSettings::exportCommands)
+		decodeLevel = HKWireAnalyzerSettings::commandlevel;
+	const bool words = decodeLevel == HKWireAnalyzerSettings::wordlevel;
+
+	const U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	const U64 sample_rate = mAnalyzer->GetSampleRate();
+	const auto tickLength = GetTickLength();
+
+	// one level for the whole file, so the header fits every row
+	writer.text( words ? "Time [s],Type,Dat\n" : "Time [s],Type,Src,Dst,Cmd,Dat\n" );
 
-		char time_str[128];
-		AnalyzerHelpers::GetTimeString( frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128 );
-		file_stream << time_str;
+	// asking Logic for every frame would cost more than the row itself
+	constexpr U64 progressInterval = 1024;
+	const U64 num_frames = GetNumFrames();
+	for( U64 i=0; i < num_frames; i++ )
+	{
+		const Frame frame = GetFrame( i );
+		if (!IsCommandFrame( frame ))
+		{
+			continue;
+		}
+		const auto record = GetRecord( frame );
+		const auto& payload = record.payload;
 
-		if (decodeLevel == HKWireAnalyzerSettings::wordlevel)
+		if (words)
 		{
-			file_stream << "," << getNameOfWordState(state);
-			if (hasWordStateData(state))
+			for (auto state = WordState::source; state != WordState::end;
+			     state = static_cast<WordState>(std::to_underlying(state) + 1))
 			{
-				char number_str[128];
-				const auto numBits = getBitsPerWord(state).value_or(8);
-				const auto payload = Payload(frame.mData1);
-				const auto data = payload.getWord(state);
-				AnalyzerHelpers::GetNumberString( data, display_base, numBits, number_str, 128 );
-				file_stream << "," << number_str;
+				if ((state == WordState::data1 && !payload.data1.has_value()) ||
+				    (state == WordState::data2 && !payload.data2.has_value()))
+				{
+					continue;
+				}
+				writer.time( record.getStartOfWord(state, tickLength), trigger_sample, sample_rate );
+				writer.put( ',' );
+				writer.text( getNameOfWordState(state) );
+				writer.put( ',' );
+				WriteNumber( writer, payload.getWord(state), display_base, getBitsPerWord(state).value_or(8) );
+				writer.put( '\n' );
 			}
 		}
 		else
 		{
 			// whole command
-			char src[16];
-			char dst[16];
-			char cmd[16];
-			char data[16] = {0};	// default: none
-			const auto payload = Payload(frame.mData1);
 			const bool withData = payload.data1.has_value();
-
-			file_stream << "," << "command";
-			if (withData)
-				file_stream << " with data";
-
-			AnalyzerHelpers::GetNumberString( payload.source, display_base, *getBitsPerWord(WordState::source), src, 16 );
-			AnalyzerHelpers::GetNumberString( payload.dest, display_base, *getBitsPerWord(WordState::dest), dst, 16 );
-			AnalyzerHelpers::GetNumberString( payload.command, display_base, *getBitsPerWord(WordState::command), cmd, 16 );
-			file_stream << "," << src << "," << dst << "," << cmd;
+			writer.time( record.start, trigger_sample, sample_rate );
+			writer.text( withData ? ",command with data," : ",command," );
+			WriteNumber( writer, payload.source, display_base, *getBitsPerWord(WordState::source) );
+			writer.put( ',' );
+			WriteNumber( writer, payload.dest, display_base, *getBitsPerWord(WordState::dest) );
+			writer.put( ',' );
+			WriteNumber( writer, payload.command, display_base, *getBitsPerWord(WordState::command) );
 			if (withData)
 			{
-				AnalyzerHelpers::GetNumberString( payload.getDataInHostOrder(), display_base, payload.getDataLength(), data, 16 );
-				file_stream << "," << data;
+				writer.put( ',' );
+				WriteNumber( writer, payload.getDataInHostOrder(), display_base, payload.getDataLength() );
 			}
+			writer.put( '\n' );
+		}
+
+		if( i % progressInterval == 0 && UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
+		{
+			break;
 		}
+	}
+	writer.close();
+}
+
+void HKWireAnalyzerResults::GenerateBinaryExportFile( ExportWriter& writer )
+{
+	BinaryExporter exporter( writer, mAnalyzer->GetSampleRate(), mAnalyzer->GetTriggerSample() );
 
-		file_stream << std::endl;
+	constexpr U64 progressInterval = 1024;
+	const U64 num_frames = GetNumFrames();
+	for( U64 i=0; i < num_frames; i++ )
+	{
+		const Frame frame = GetFrame( i );
+		if (IsCommandFrame( frame ))
+		{
+			exporter.add( GetRecord( frame ) );
+		}
 
-		if( UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
+		if( i % progressInterval == 0 && UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
 		{
+			// still a valid file, with what we have so far
 			break;
 		}
 	}
+	exporter.finish();
+}
 
-	file_stream.close();
+void HKWireAnalyzerResults::GeneratePcapExportFile( ExportWriter& writer )
+{
+	PcapExporter exporter( writer, mAnalyzer->GetSampleRate() );
+
+	constexpr U64 progressInterval = 1024;
+	const U64 num_frames = GetNumFrames();
+	for( U64 i=0; i < num_frames; i++ )
+	{
+		const Frame frame = GetFrame( i );
+		if (IsCommandFrame( frame ))
+		{
+			exporter.add( GetRecord( frame ) );
+		}
+
+		if( i % progressInterval == 0 && UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
+		{
+			break;
+		}
+	}
+}
+
+void HKWireAnalyzerResults::GenerateDiagnosticsExportFile( ExportWriter& writer )
+{
+	DrainDiagnostics();
+	std::lock_guard< std::mutex > lock( mDrainMutex );
+
+	const U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	const U64 sample_rate = mAnalyzer->GetSampleRate();
+	writer.text( "Time [s],Sample,Kind,State\n" );
+	for (const auto& diagnostic : mDrainedDiagnostics)
+	{
+		writer.time( diagnostic.sample, trigger_sample, sample_rate );
+		writer.put( ',' );
+		writer.decimal( diagnostic.sample );
+		writer.put( ',' );
+		writer.text( getNameOfDiagnosticKind( diagnostic.kind ) );
+		writer.put( ',' );
+		if (diagnostic.kind != DiagnosticKind::lost)
+		{
+			writer.text( getNameOfWordState( diagnostic.state ) );
+		}
+		writer.put( '\n' );
+	}
+	if (const U64 dropped = mDiagnostics.getNumDropped() + mNumUnloggedDiagnostics)
+	{
+		// more than fit into the ring between two exports, or into the log
+		writer.text( "# " );
+		writer.decimal( dropped );
+		writer.text( " more not recorded\n" );
+	}
+}
+
+void HKWireAnalyzerResults::GenerateStatisticsExportFile( ExportWriter& writer )
+{
+	// collected while analyzing, no pass over the frames needed
+	std::lock_guard< std::mutex > lock( mStatisticsMutex );
+	if (mStatistics != nullptr)
+	{
+		mStatistics->write( writer, mAnalyzer->GetTriggerSample() );
+	}
 }
 
 void HKWireAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase display_base )
@@ -175,13 +422,31 @@ void HKWireAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBa
 #endif
 }
 
-void HKWireAnalyzerResults::GeneratePacketTabularText( U64 packet_id, DisplayBase display_base )
+HKWireAnalyzerResults::CommandText HKWireAnalyzerResults::FormatPacket( U64 packet_id, DisplayBase display_base )
 {
-	//not yet? supported
+	U64 first_frame_id;
+	U64 last_frame_id;
+	GetFramesContainedInPacket( packet_id, &first_frame_id, &last_frame_id );
+	// the command (or its last word) closes its packet, BUSY held before it may come first
+	return FormatCommand( Payload(GetFrame( last_frame_id ).mData1), display_base );
+}
 
+void HKWireAnalyzerResults::GeneratePacketTabularText( U64 packet_id, DisplayBase display_base )
+{
+	ClearTabularText();
+	AddTabularText( FormatPacket( packet_id, display_base ).line );
 }
 
 void HKWireAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base )
 {
-	//not supported
-}
\ No newline at end of file
+	ClearTabularText();
+	U64* packet_ids;
+	U64 packet_id_count;
+	GetPacketsContainedInTransaction( transaction_id, &packet_ids, &packet_id_count );
+	if (packet_id_count < 2)
+	{
+		return;
+	}
+	// request, then answer
+	AddTabularText( FormatPacket( packet_ids[0], display_base ).line, " => ", FormatPacket( packet_ids[1], display_base ).line );
+}
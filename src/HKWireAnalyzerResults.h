@@ -2,6 +2,14 @@
 #define HKWire_ANALYZER_RESULTS
 
 #include <AnalyzerResults.h>
+#include "HKWireRecord.h"
+#include "HKWireExport.h"
+#include "HKWireDiagnostics.h"
+#include "HKWireStatistics.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class HKWireAnalyzer;
 class HKWireAnalyzerSettings;
@@ -19,11 +27,72 @@ public:
 	virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
 	virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
+	// Frame::mType. Commands are whole, but at word level, where there is a frame per word
+	// with the WordState as type. The rest is BUSY held outside of a command or capture
+	// that could not be decoded.
+	static constexpr U8 commandFrame = std::to_underlying( HKWire::WordState::end );
+	static constexpr U8 busyFrame = std::to_underlying( HKWire::WordState::_num );
+	static constexpr U8 lostFrame = busyFrame + 1;
+
+	// filled by the analysis thread, emptied by the diagnostics export only
+	using Diagnostics = HKWire::DiagnosticsRing< 1 << 14 >;
+	Diagnostics& GetDiagnostics();
+	// what the log of the exports keeps, 1 MiB. The rest is only counted.
+	static constexpr size_t maxLoggedDiagnostics = 1 << 16;
+
+	// per run, before the first command
+	void StartStatistics( U64 sample_rate );
+	// from the analysis thread, while the summary export might be reading
+	template< typename Update >
+	void UpdateStatistics( Update&& update )
+	{
+		std::lock_guard< std::mutex > lock( mStatisticsMutex );
+		if (mStatistics != nullptr)
+		{
+			update( *mStatistics );
+		}
+	}
+
 protected: //functions
+	// the whole command, or the last word of it
+	bool IsCommandFrame( const Frame& frame ) const;
+	// of a frame for which IsCommandFrame()
+	HKWire::CommandRecord GetRecord( const Frame& frame ) const;
+	void GenerateWordBubbleText( const Frame& frame, DisplayBase display_base );
+	// the numbers of a command, the same in bubbles, packets and transactions
+	struct CommandText
+	{
+		char src[16];
+		char dst[16];
+		char cmd[16];
+		char data[16];	// with a space before, empty without data
+		char line[64];	// "src -> dst : cmd data"
+	};
+	CommandText FormatCommand( const HKWire::Payload& payload, DisplayBase display_base ) const;
+	// moves everything from the ring into the log of the exports
+	void DrainDiagnostics();
+	void GenerateBusyBubbleText( const Frame& frame, DisplayBase display_base );
+	void GenerateLostBubbleText( const Frame& frame, DisplayBase display_base );
+	HKWire::TickLength GetTickLength() const;
+	void GenerateBinaryExportFile( HKWire::ExportWriter& writer );
+	void GeneratePcapExportFile( HKWire::ExportWriter& writer );
+	void GenerateDiagnosticsExportFile( HKWire::ExportWriter& writer );
+	void GenerateStatisticsExportFile( HKWire::ExportWriter& writer );
+	// of the command in `packet_id`
+	CommandText FormatPacket( U64 packet_id, DisplayBase display_base );
 
 protected:  //vars
 	HKWireAnalyzerSettings* mSettings;
 	HKWireAnalyzer* mAnalyzer;
+
+	Diagnostics mDiagnostics;
+	// drained so far, oldest first, exports may run more than once
+	std::vector< HKWire::Diagnostic > mDrainedDiagnostics;
+	U64 mNumUnloggedDiagnostics;	// drained after the log was full
+	std::mutex mDrainMutex;
+
+	std::unique_ptr< HKWire::BusStatistics > mStatistics;
+	std::mutex mStatisticsMutex;
 };
 
 #endif //HKWire_ANALYZER_RESULTS
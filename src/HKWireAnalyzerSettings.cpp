@@ -1,41 +1,104 @@
 #include "HKWireAnalyzerSettings.h"
 #include <AnalyzerHelpers.h>
 
+#include <memory>
+
 const char* const HKWireAnalyzerSettings::dataChannelName = "HK Onewire Data";
 const char* const HKWireAnalyzerSettings::busyChannelName = "HK Onewire Busy";
 
 
 HKWireAnalyzerSettings::HKWireAnalyzerSettings()
 :	mDataChannel( UNDEFINED_CHANNEL ),
-	mTimeBase_us( 560 )
+	mOptionalBusyChannel( UNDEFINED_CHANNEL ),
+	mTimeBase_us( defaultTimeBase_us ),
+	mGlitchFilter_percent( defaultGlitchFilter_percent ),
+	mStartTolerance_percent( defaultTolerance_percent ),
+	mData1Tolerance_percent( defaultTolerance_percent ),
+	mData0Tolerance_percent( defaultTolerance_percent ),
+	mDecodeLevel( wordlevel ),
+	mMarkerDensity( allMarkers )
 {
 	mInputChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
 	mInputChannelInterface->SetTitleAndTooltip( "Data", "Standard B&O Onewire Data" );
 	mInputChannelInterface->SetChannel( mDataChannel );
 
+	mBusyChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+	mBusyChannelInterface->SetTitleAndTooltip( "Busy (optional)", "Pin 7, low while a unit holds the bus. Shows bus occupancy and ends transmissions without waiting for the idle line." );
+	mBusyChannelInterface->SetChannel( mOptionalBusyChannel );
+	mBusyChannelInterface->SetSelectionOfNoneIsAllowed( true );
+
 	mTimeBaseInterface.reset( new AnalyzerSettingInterfaceInteger() );
 	mTimeBaseInterface->SetTitleAndTooltip( "Time Base of one tick (microseconds)",
-										   "Specify the microseconds per tick." );
+										   "Specify the microseconds per tick, 0 detects it from the first transmissions." );
 	mTimeBaseInterface->SetMax( 6000000 );
-	mTimeBaseInterface->SetMin( 1 );
+	mTimeBaseInterface->SetMin( autoTimeBase );
 	mTimeBaseInterface->SetInteger( mTimeBase_us );
 
+	mGlitchFilterInterface.reset( new AnalyzerSettingInterfaceInteger() );
+	mGlitchFilterInterface->SetTitleAndTooltip( "Glitch filter (% of a tick)",
+										   "Shorter spikes on the line are ignored instead of breaking the transmission, 0 turns this off." );
+	mGlitchFilterInterface->SetMax( 50 );
+	mGlitchFilterInterface->SetMin( 0 );
+	mGlitchFilterInterface->SetInteger( mGlitchFilter_percent );
+
+	const auto makeToleranceInterface = []( const char* title, const U32& tolerance_percent )
+	{
+		auto setting = std::make_unique< AnalyzerSettingInterfaceInteger >();
+		setting->SetTitleAndTooltip( title,
+			"How far a low pulse may be off its length and still count as this bit, 50 rounds to the nearest tick." );
+		setting->SetMax( 200 );
+		setting->SetMin( 1 );
+		setting->SetInteger( tolerance_percent );
+		return setting;
+	};
+	mStartToleranceInterface = makeToleranceInterface( "Start bit tolerance (% of a tick)", mStartTolerance_percent );
+	mData1ToleranceInterface = makeToleranceInterface( "Data 1 tolerance (% of a tick)", mData1Tolerance_percent );
+	mData0ToleranceInterface = makeToleranceInterface( "Data 0 / end bit tolerance (% of a tick)", mData0Tolerance_percent );
+
 	mPacketLevelDecodeInterface.reset(new AnalyzerSettingInterfaceNumberList());
 	mPacketLevelDecodeInterface->SetTitleAndTooltip( "Decode level",
 										   "Define word or command level decoding" );
 	mPacketLevelDecodeInterface->AddNumber(wordlevel, "Word level", "Decode individual words");
 	mPacketLevelDecodeInterface->AddNumber(commandlevel, "Command level", "Decode complete commands");
 	mPacketLevelDecodeInterface->AddNumber(textlevel, "Command interpret level", "Decode and (try) interpret complete commands");
+	mPacketLevelDecodeInterface->SetNumber( mDecodeLevel );
+
+	mMarkerDensityInterface.reset(new AnalyzerSettingInterfaceNumberList());
+	mMarkerDensityInterface->SetTitleAndTooltip( "Bit markers",
+										   "Markers per bit cost a lot of memory on long captures" );
+	mMarkerDensityInterface->AddNumber(allMarkers, "Every bit", "Mark every received bit");
+	mMarkerDensityInterface->AddNumber(errorMarkers, "Errors only", "Mark errors, and the bits of the transmission they occurred in");
+	mMarkerDensityInterface->AddNumber(noMarkers, "None", "Only mark the errors themselves");
+	mMarkerDensityInterface->SetNumber( mMarkerDensity );
 
 	AddInterface( mInputChannelInterface.get() );
+	AddInterface( mBusyChannelInterface.get() );
 	AddInterface( mTimeBaseInterface.get() );
+	AddInterface( mGlitchFilterInterface.get() );
+	AddInterface( mStartToleranceInterface.get() );
+	AddInterface( mData1ToleranceInterface.get() );
+	AddInterface( mData0ToleranceInterface.get() );
 	AddInterface( mPacketLevelDecodeInterface.get() );
-
-	AddExportOption( 0, "Export as text/csv file" );
-	AddExportExtension( 0, "csv", "csv" ); // this might be interesting some day
+	AddInterface( mMarkerDensityInterface.get() );
+
+	AddExportOption( exportDecodeLevel, "Export as text/csv file" );
+	AddExportExtension( exportDecodeLevel, "csv", "csv" ); // this might be interesting some day
+	AddExportOption( exportWords, "Export words as text/csv file" );
+	AddExportExtension( exportWords, "csv", "csv" );
+	AddExportOption( exportCommands, "Export commands as text/csv file" );
+	AddExportExtension( exportCommands, "csv", "csv" );
+	AddExportOption( exportBinary, "Export commands as binary file" );
+	AddExportExtension( exportBinary, "binary", "hkw" );
+	AddExportOption( exportPcap, "Export commands as pcap file" );
+	AddExportExtension( exportPcap, "pcap", "pcap" );
+	AddExportOption( exportDiagnostics, "Export decode errors as text/csv file" );
+	AddExportExtension( exportDiagnostics, "csv", "csv" );
+	AddExportOption( exportStatistics, "Export bus statistics as text/csv file" );
+	AddExportExtension( exportStatistics, "csv", "csv" );
 
 	ClearChannels();
 	AddChannel( mDataChannel, dataChannelName, false );
+	AddChannel( mOptionalBusyChannel, busyChannelName, false );
 }
 
 HKWireAnalyzerSettings::~HKWireAnalyzerSettings()
@@ -45,12 +108,23 @@ HKWireAnalyzerSettings::~HKWireAnalyzerSettings()
 bool HKWireAnalyzerSettings::SetSettingsFromInterfaces()
 {
 	mDataChannel = mInputChannelInterface->GetChannel();
+	mOptionalBusyChannel = mBusyChannelInterface->GetChannel();
+	if (mOptionalBusyChannel == mDataChannel)
+	{
+		SetErrorText( "Busy has to be a different channel than Data." );
+		return false;
+	}
 	mTimeBase_us = mTimeBaseInterface->GetInteger();
+	mGlitchFilter_percent = mGlitchFilterInterface->GetInteger();
+	mStartTolerance_percent = mStartToleranceInterface->GetInteger();
+	mData1Tolerance_percent = mData1ToleranceInterface->GetInteger();
+	mData0Tolerance_percent = mData0ToleranceInterface->GetInteger();
 	mDecodeLevel = static_cast<DecodeLevel>(mPacketLevelDecodeInterface->GetNumber());
+	mMarkerDensity = static_cast<MarkerDensity>(mMarkerDensityInterface->GetNumber());
 
 	ClearChannels();
 	AddChannel( mDataChannel, dataChannelName, true );
-	// AddChannel( mOptionalBusyChannel, busyChannelName, false );
+	AddChannel( mOptionalBusyChannel, busyChannelName, hasBusyChannel() );
 
 	return true;
 }
@@ -58,8 +132,14 @@ bool HKWireAnalyzerSettings::SetSettingsFromInterfaces()
 void HKWireAnalyzerSettings::UpdateInterfacesFromSettings()
 {
 	mInputChannelInterface->SetChannel( mDataChannel );
+	mBusyChannelInterface->SetChannel( mOptionalBusyChannel );
 	mTimeBaseInterface->SetInteger( mTimeBase_us );
+	mGlitchFilterInterface->SetInteger( mGlitchFilter_percent );
+	mStartToleranceInterface->SetInteger( mStartTolerance_percent );
+	mData1ToleranceInterface->SetInteger( mData1Tolerance_percent );
+	mData0ToleranceInterface->SetInteger( mData0Tolerance_percent );
 	mPacketLevelDecodeInterface->SetNumber( mDecodeLevel );
+	mMarkerDensityInterface->SetNumber( mMarkerDensity );
 }
 
 void HKWireAnalyzerSettings::LoadSettings( const char* settings )
@@ -71,10 +151,31 @@ void HKWireAnalyzerSettings::LoadSettings( const char* settings )
 	text_archive >> mTimeBase_us;
 	double intermediate;
 	text_archive >> intermediate;
-	mPacketLevelDecodeInterface->SetNumber(intermediate);
+	mDecodeLevel = static_cast<DecodeLevel>(intermediate);
+	// not there in older settings
+	if (text_archive >> intermediate)
+	{
+		mMarkerDensity = static_cast<MarkerDensity>(intermediate);
+	}
+	if (!(text_archive >> mOptionalBusyChannel))
+	{
+		mOptionalBusyChannel = UNDEFINED_CHANNEL;
+	}
+	if (!(text_archive >> mGlitchFilter_percent))
+	{
+		mGlitchFilter_percent = defaultGlitchFilter_percent;
+	}
+	if (!(text_archive >> mStartTolerance_percent && text_archive >> mData1Tolerance_percent &&
+	      text_archive >> mData0Tolerance_percent))
+	{
+		mStartTolerance_percent = defaultTolerance_percent;
+		mData1Tolerance_percent = defaultTolerance_percent;
+		mData0Tolerance_percent = defaultTolerance_percent;
+	}
 
 	ClearChannels();
 	AddChannel( mDataChannel, dataChannelName, true );
+	AddChannel( mOptionalBusyChannel, busyChannelName, hasBusyChannel() );
 
 	UpdateInterfacesFromSettings();
 }
@@ -86,6 +187,12 @@ const char* HKWireAnalyzerSettings::SaveSettings()
 	text_archive << mDataChannel;
 	text_archive << mTimeBase_us;
 	text_archive << mPacketLevelDecodeInterface->GetNumber();
+	text_archive << mMarkerDensityInterface->GetNumber();
+	text_archive << mOptionalBusyChannel;
+	text_archive << mGlitchFilter_percent;
+	text_archive << mStartTolerance_percent;
+	text_archive << mData1Tolerance_percent;
+	text_archive << mData0Tolerance_percent;
 
 	return SetReturnString( text_archive.GetString() );
 }
@@ -4,6 +4,8 @@
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
 
+#include "HKWireDecoder.h"
+
 class HKWireAnalyzerSettings : public AnalyzerSettings
 {
 public:
@@ -20,8 +22,17 @@ public:
 
 
 	Channel mDataChannel;
-	// Channel mOptionalBusyChannel;
-	U64 mTimeBase_us;
+	Channel mOptionalBusyChannel;	// UNDEFINED_CHANNEL if not connected
+	U64 mTimeBase_us;	// autoTimeBase: found from the first pulses
+	static constexpr U64 autoTimeBase = 0;
+	static constexpr U64 defaultTimeBase_us = 560;
+	U32 mGlitchFilter_percent;	// of a tick, shorter levels are dropped. 0 is off
+	static constexpr U32 defaultGlitchFilter_percent = 10;	// HKWire::GlitchFilter::defaultWidth_ticks
+	// of a tick, accepted deviation of a low pulse, see HKWire::PulseTolerance
+	U32 mStartTolerance_percent;
+	U32 mData1Tolerance_percent;
+	U32 mData0Tolerance_percent;
+	static constexpr U32 defaultTolerance_percent = 50;
 
 	enum DecodeLevel : uint8_t
 	{
@@ -30,6 +41,45 @@ public:
 		textlevel,
 	} mDecodeLevel;
 
+	enum MarkerDensity : uint8_t
+	{
+		allMarkers = 0,
+		errorMarkers,	// bit markers only for broken transmissions
+		noMarkers,		// error markers are always kept
+	} mMarkerDensity;
+
+	// export options, besides the one following mDecodeLevel
+	enum ExportType : U32
+	{
+		exportDecodeLevel = 0,
+		exportWords,
+		exportCommands,
+		exportBinary,	// see HKWireBinaryExport.h
+		exportPcap,		// see HKWirePcapExport.h
+		exportDiagnostics,	// decode errors, see HKWireDiagnostics.h
+		exportStatistics,	// see HKWireStatistics.h
+	};
+
+	// what to expect before anything was recorded
+	inline U64
+	getNominalTimeBase_us() const
+	{
+		return mTimeBase_us == autoTimeBase ? defaultTimeBase_us : mTimeBase_us;
+	}
+
+	inline HKWire::PulseTolerance
+	getPulseTolerance() const
+	{
+		return HKWire::PulseTolerance{mStartTolerance_percent / 100., mData1Tolerance_percent / 100.,
+		                              mData0Tolerance_percent / 100.};
+	}
+
+	inline bool
+	hasBusyChannel() const
+	{
+		return mOptionalBusyChannel != UNDEFINED_CHANNEL;
+	}
+
 	inline bool
 	isCommandLevel() const
 	{
@@ -38,8 +88,14 @@ public:
 
 protected:
 	std::unique_ptr< AnalyzerSettingInterfaceChannel >	mInputChannelInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceChannel >	mBusyChannelInterface;
 	std::unique_ptr< AnalyzerSettingInterfaceInteger >	mTimeBaseInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceInteger >	mGlitchFilterInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceInteger >	mStartToleranceInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceInteger >	mData1ToleranceInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceInteger >	mData0ToleranceInterface;
 	std::unique_ptr< AnalyzerSettingInterfaceNumberList > mPacketLevelDecodeInterface;
+	std::unique_ptr< AnalyzerSettingInterfaceNumberList > mMarkerDensityInterface;
 };
 
 #endif //HKWire_ANALYZER_SETTINGS
@@ -0,0 +1,50 @@
+#include "HKWireBinaryExport.h"
+
+using namespace HKWire;
+using namespace HKWire::BinaryFormat;
+
+BinaryExporter::BinaryExporter(ExportWriter& writer, const U64& sampleRate_Hz, const U64& triggerSample)
+	: mWriter{writer},
+	  mIndex{},
+	  mNumRecords{0}
+{
+	mWriter.write(magic, sizeof(magic));
+	mWriter.littleEndian(sampleRate_Hz, 8);
+	mWriter.littleEndian(triggerSample, 8);
+	mWriter.littleEndian(recordSize, 4);
+	mWriter.littleEndian(indexInterval, 4);
+}
+
+void
+BinaryExporter::add(const CommandRecord& record)
+{
+	const auto& payload = record.payload;
+	if (mNumRecords % indexInterval == 0)
+	{
+		mIndex.push_back(IndexEntry{record.start, headerSize + mNumRecords * recordSize});
+	}
+	mWriter.littleEndian(record.start, 8);
+	mWriter.littleEndian(record.end, 8);
+	mWriter.littleEndian(payload.source, 1);
+	mWriter.littleEndian(payload.dest, 1);
+	mWriter.littleEndian(payload.command, 1);
+	mWriter.littleEndian(payload.getDataLength() / 8, 1);
+	mWriter.littleEndian(payload.getDataInHostOrder(), 2);
+	mWriter.littleEndian(0, 2);
+	mNumRecords++;
+}
+
+void
+BinaryExporter::finish()
+{
+	const U64 indexOffset = headerSize + mNumRecords * recordSize;
+	for (const auto& entry : mIndex)
+	{
+		mWriter.littleEndian(entry.start, 8);
+		mWriter.littleEndian(entry.offset, 8);
+	}
+	mWriter.littleEndian(mNumRecords, 8);
+	mWriter.littleEndian(indexOffset, 8);
+	mWriter.littleEndian(mIndex.size(), 8);
+	mWriter.write(magic, sizeof(magic));
+}
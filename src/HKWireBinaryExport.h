@@ -0,0 +1,58 @@
+#pragma once
+
+#include "HKWireExport.h"
+#include "HKWireRecord.h"
+
+#include <vector>
+
+namespace HKWire
+{
+	// Binary command export, meant to be memory mapped instead of parsed.
+	// Everything is little endian.
+	//
+	//   header  (32 bytes)  magic, U64 sample rate, U64 trigger sample,
+	//                       U32 record size, U32 index interval
+	//   records (24 bytes)  U64 start, U64 end, U8 source, U8 dest, U8 command,
+	//                       U8 data length in bytes, U16 data (host order), U16 reserved
+	//   index   (16 bytes)  U64 start sample, U64 file offset of the record;
+	//                       for every `indexInterval`th record
+	//   footer  (32 bytes)  U64 number of records, U64 file offset of the index,
+	//                       U64 number of index entries, magic
+	//
+	// Records are sorted by start, so the index only saves the first few steps
+	// of a binary search over the records themselves.
+	namespace BinaryFormat
+	{
+		constexpr char magic[8] = {'H', 'K', 'W', 'i', 'r', 'e', '\0', '\x01'};	// last byte is the version
+		constexpr size_t headerSize = 32;
+		constexpr size_t recordSize = 24;
+		constexpr size_t indexEntrySize = 16;
+		constexpr size_t footerSize = 32;
+		constexpr U32 indexInterval = 256;
+	}
+
+	class BinaryExporter
+	{
+	public:
+		// writes the header right away
+		BinaryExporter(ExportWriter& writer, const U64& sampleRate_Hz, const U64& triggerSample);
+
+		void
+		add(const CommandRecord& record);
+
+		// index and footer, nothing may be added afterwards
+		void
+		finish();
+
+	private:
+		struct IndexEntry
+		{
+			U64 start;
+			U64 offset;
+		};
+
+		ExportWriter& mWriter;
+		std::vector<IndexEntry> mIndex;
+		U64 mNumRecords;
+	};
+}
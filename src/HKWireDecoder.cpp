@@ -0,0 +1,384 @@
+#include "HKWireDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace HKWire;
+
+PulseClassifier::PulseClassifier(const U64& unitsPerTick, const PulseTolerance& tolerance)
+	: mTable{}
+{
+	// data0 before end, see BitType. Where windows overlap the later one wins,
+	// so the start bit goes before data1 and data1 before data0.
+	const std::pair<BitType, double> windows[] = {{BitType::data0, tolerance.data0},
+	                                              {BitType::data1, tolerance.data1},
+	                                              {BitType::start, tolerance.start}};
+	for (const auto& [type, toleranceTicks] : windows)
+	{
+		const U64 nominal = getWaveformForBit(type)->low * unitsPerTick;
+		// (nominal - ceil(t), nominal + floor(t)], which is what matchSamplesToTicks does for 0.5
+		const double toleranceUnits = toleranceTicks * unitsPerTick;
+		const U64 below = std::min<U64>(nominal, std::ceil(toleranceUnits));
+		const U64 above = std::floor(toleranceUnits);
+		if (mTable.size() <= nominal + above)
+		{
+			mTable.resize(nominal + above + 1, invalid);
+		}
+		std::fill(mTable.begin() + (nominal - below + 1), mTable.begin() + (nominal + above + 1),
+		          std::to_underlying(type));
+	}
+}
+
+namespace
+{
+	constexpr U64
+	getInverse(const TickLength& tickLength, const unsigned& shift)
+	{
+		return (TickClock::unitsPerTick << (shift + TickLength::fractionBits)) / std::max<U64>(tickLength.raw, 1);
+	}
+
+	constexpr U64
+	getMaxSamples(const TickLength& tickLength)
+	{
+		return (TickClock::maxUnits / TickClock::unitsPerTick * tickLength.raw) >> TickLength::fractionBits;
+	}
+}
+
+TickClock::TickClock(const TickLength& nominal)
+	: mNominal{nominal},
+	  // a fifth either way is more than any unit showed, this only keeps noise from running away
+	  mMin{nominal.raw - nominal.raw / 5},
+	  mMax{nominal.raw + nominal.raw / 5},
+	  mTickLength{nominal},
+	  mInverse{0},
+	  mMaxSamples{0},
+	  mNominalInverse{getInverse(nominal, inverseShift)},
+	  mMaxNominalSamples{getMaxSamples(nominal)},
+	  mTrackedSamplesTimesTicks{0},
+	  mTrackedTicksSquared{0}
+{
+	update();
+}
+
+U64
+TickClock::toNominalTicks(const U64& samples) const
+{
+	return ((samples << TickLength::fractionBits) + mNominal.raw / 2) / mNominal.raw;
+}
+
+void
+TickClock::resync(const U64& samples, const Ticks& ticks)
+{
+	mTrackedSamplesTimesTicks = mTickLength.raw * priorWeight + ((samples * ticks) << TickLength::fractionBits);
+	mTrackedTicksSquared = priorWeight + ticks * ticks;
+	update();
+}
+
+void
+TickClock::track(const U64& samples, const Ticks& ticks)
+{
+	if (mTrackedTicksSquared == 0)
+	{
+		// no start bit yet, so start out from the configured tick.
+		// Otherwise a clock too far off for the start bit window would never be found.
+		mTrackedSamplesTimesTicks = mTickLength.raw * priorWeight;
+		mTrackedTicksSquared = priorWeight;
+	}
+	mTrackedSamplesTimesTicks += (samples * ticks) << TickLength::fractionBits;
+	mTrackedTicksSquared += ticks * ticks;
+	if (mTrackedTicksSquared > maxTrackedWeight)
+	{
+		mTrackedSamplesTimesTicks /= 2;
+		mTrackedTicksSquared /= 2;
+	}
+}
+
+void
+TickClock::update()
+{
+	U64 raw = mNominal.raw;
+	if (mTrackedTicksSquared > 0)
+	{
+		raw = std::clamp(mTrackedSamplesTimesTicks / mTrackedTicksSquared, mMin.raw, mMax.raw);
+	}
+	mTickLength = TickLength{std::max<U64>(raw, 1)};
+	mInverse = getInverse(mTickLength, inverseShift);
+	mMaxSamples = getMaxSamples(mTickLength);
+}
+
+Decoder::Decoder(DecoderListener& listener, const TickLength& tickLength, const PulseTolerance& tolerance,
+                 const double& glitch_ticks)
+	: mListener{listener},
+	  mClock{tickLength},
+	  mClassifier{TickClock::unitsPerTick, tolerance},
+	  mGlitchFilter{U64(std::llround(glitch_ticks * tickLength.raw / TickLength::one))},
+	  mState{},
+	  mWordOffsets{},
+	  mPendingFallingEdge{0},
+	  mPendingRisingEdge{0},
+	  mHasPendingPulse{false},
+	  mExpectFallingEdge{true},
+	  mInTransmission{false},
+	  mResyncing{false},
+	  mHasLostStretch{false},
+	  mLostStart{0},
+	  mLostEnd{0},
+	  mLostSamples{0}
+{
+}
+
+void
+Decoder::loseSync(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime)
+{
+	mLostStart = mInTransmission ? mState.startOfTransmission : fallingEdge;
+	mInTransmission = false;
+	mLostEnd = risingEdge;
+	mHasLostStretch = true;
+	mResyncing = true;
+	mState.reset();
+	if (highTime == HighTime::idleEnd)
+	{
+		// this was its last pulse anyway
+		reportLost();
+	}
+}
+
+bool
+Decoder::skipUntilStart(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime)
+{
+	const auto lowPulseLength = risingEdge - fallingEdge;
+	const auto bitType = classify(lowPulseLength);
+	// The window of the start bit does not overlap any other, so this is all it takes.
+	if (bitType == BitType::start)
+	{
+		if (mHasLostStretch)
+		{
+			reportLost();
+		}
+		mResyncing = false;
+		return false;
+	}
+	if (!mHasLostStretch)
+	{
+		// a transmission whose start bit got lost
+		mLostStart = fallingEdge;
+		mHasLostStretch = true;
+	}
+	mLostEnd = risingEdge;
+	if (bitType.has_value())
+	{
+		// keeps following a sender clock that is off, or its next start bit is missed as well
+		mClock.track(lowPulseLength, getWaveformForBit(*bitType)->low);
+	}
+	// A short high might just as well be a glitch, back to back transmissions
+	// end at the next start bit anyway.
+	if (highTime == HighTime::idleEnd)
+	{
+		reportLost();
+	}
+	return true;
+}
+
+void
+Decoder::reportLost()
+{
+	mHasLostStretch = false;
+	mLostSamples += mLostEnd - mLostStart;
+	mListener.onLost(mLostStart, mLostEnd);
+}
+
+std::optional<BitType>
+Decoder::classify(const U64& lowPulseLength)
+{
+	auto maybeBitType = mClassifier.classify(mClock.toUnits(lowPulseLength));
+	if (!maybeBitType.has_value())
+	{
+		// The estimate is only updated once per transmission, the bits since then may know better.
+		mClock.update();
+		maybeBitType = mClassifier.classify(mClock.toUnits(lowPulseLength));
+	}
+	if (!maybeBitType.has_value())
+	{
+		// The estimate is only as good as the pulses it came from, with a lot of jitter
+		// it might be worse than the configured one. The windows are ticks apart,
+		// so this can not turn a wrong bit into a valid one.
+		// The pulse still goes into the estimate below, which pulls it back.
+		maybeBitType = mClassifier.classify(mClock.toNominalUnits(lowPulseLength));
+	}
+	return maybeBitType;
+}
+
+void
+Decoder::pulse(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime)
+{
+	if (mResyncing && skipUntilStart(fallingEdge, risingEdge, highTime)) [[unlikely]]
+	{
+		return;
+	}
+
+	const auto lowPulseLength = risingEdge - fallingEdge;
+	const auto centerOfLowPulse = fallingEdge + lowPulseLength / 2;
+
+	auto maybeBitType = classify(lowPulseLength);
+	if (!maybeBitType.has_value())
+	{
+		// Üeh
+		mListener.onMarker(centerOfLowPulse, Marker::invalidPulse, mState);
+		// nothing good will come from this.
+		loseSync(fallingEdge, risingEdge, highTime);
+		return;
+	}
+	auto& bitType = *maybeBitType;
+	if (bitType == BitType::start)
+	{
+		mClock.resync(lowPulseLength, getWaveformForBit(bitType)->low);
+	}
+	else
+	{
+		mClock.track(lowPulseLength, getWaveformForBit(bitType)->low);
+	}
+
+	// check duration of stop (high) pulse
+	// end byte only differs by high-duration.
+	// This is observed to be about 8ms, or just one Tick if busy.
+	// Could be checked by "busy" line,
+	// but this is not necessary (just greater than 2 ticks or equal to one tick)
+	// or implied through the number of observed bits (TODO)
+	if (highTime != HighTime::regular)
+	{
+		// this is an end bit
+		bitType = BitType::end;
+	}
+
+	if (mState.currentNumberOfBitsReceived == 0)
+	{
+		// could have been estimated in the transition, but this is cleaner.
+		mState.startOfCurrentWord = fallingEdge;
+	}
+
+	// now let's reason about this bit.
+	Marker marker;
+	switch (bitType)
+	{
+		case BitType::start:
+			// start state.
+			mState = HKWireState(fallingEdge);
+			mWordOffsets = {};
+			mInTransmission = true;
+			marker = Marker::start;
+			break;
+		case BitType::data1:
+			mState.setCurrentBit(1);
+			marker = Marker::data1;
+			break;
+		case BitType::data0:
+			mState.setCurrentBit(0);
+			marker = Marker::data0;
+			break;
+		case BitType::end:
+			marker = highTime == HighTime::busyEnd ? Marker::busyEnd : Marker::idleEnd;
+			// this could indicate the actual state, but
+			// knowledge about whether we had data is
+			// easier to keep with the state than an extra bool
+			break;
+		default:
+			// not reachable, all waveforms are handled above
+			mListener.onMarker(centerOfLowPulse, Marker::invalidPulse, mState);
+			loseSync(fallingEdge, risingEdge, highTime);
+			return;
+	}
+	mState.currentNumberOfBitsReceived++;
+	mListener.onMarker(centerOfLowPulse, marker, mState);
+
+	// check for transition
+	const auto canAdvanceState = mState.canAdvanceState(bitType);
+	if (!canAdvanceState.has_value())
+	{
+		// PS.: It is ok that we already wrote into something,
+		// we have a buffer of one byte (because of ::_num)
+		mListener.onMarker(centerOfLowPulse, Marker::invalidState, mState);
+		loseSync(fallingEdge, risingEdge, highTime);
+		return;
+	}
+	if (canAdvanceState.value())
+	{
+		const U64 endOfFrame = risingEdge + mClock.getTickLength().getSamples();
+		// once per word, so the division does not hurt
+		const U64 offset = mClock.toNominalTicks(mState.startOfCurrentWord - mState.startOfTransmission);
+		// the end bit may come in place of a data word
+		const auto word = bitType == BitType::end ? WordState::end : mState.wordState;
+		mWordOffsets[std::to_underlying(word)] = std::min<U64>(offset, CommandRecord::maxOffset_ticks);
+		if (bitType == BitType::end)
+		{
+			mClock.update();
+			mInTransmission = false;
+			mListener.onCommand(CommandRecord{mState.startOfTransmission, endOfFrame, mState.payload, mWordOffsets});
+		}
+		else if (hasWordStateData(mState.wordState))
+		{
+			mListener.onWord(mState, endOfFrame);
+		}
+
+		mState.advanceState();
+		mListener.onAdvance(mState);
+	}
+}
+
+void
+Decoder::fallingEdge(const U64& sample)
+{
+	if (mHasPendingPulse)
+	{
+		mHasPendingPulse = false;
+		pulse(mPendingFallingEdge, mPendingRisingEdge, classifyHighTime(sample - mPendingRisingEdge));
+	}
+	mPendingFallingEdge = sample;
+	mExpectFallingEdge = false;
+}
+
+void
+Decoder::risingEdge(const U64& sample)
+{
+	mPendingRisingEdge = sample;
+	mHasPendingPulse = true;
+	mExpectFallingEdge = true;
+}
+
+void
+Decoder::finish()
+{
+	mGlitchFilter.flush([this](const U64& sample)
+	{
+		edge(sample);
+	});
+	if (mHasPendingPulse)
+	{
+		mHasPendingPulse = false;
+		pulse(mPendingFallingEdge, mPendingRisingEdge, HighTime::idleEnd);
+	}
+	if (mHasLostStretch)
+	{
+		reportLost();
+	}
+}
+
+void
+Decoder::decode(std::span<const U64> edges)
+{
+	if (mGlitchFilter.isEnabled())
+	{
+		for (const auto& sample : edges)
+		{
+			mGlitchFilter.edge(sample, [this](const U64& filtered)
+			{
+				edge(filtered);
+			});
+		}
+		return;
+	}
+	for (const auto& sample : edges)
+	{
+		edge(sample);
+	}
+}
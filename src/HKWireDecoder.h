@@ -0,0 +1,400 @@
+#pragma once
+
+#include "HKWire.h"
+#include "HKWireRecord.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace HKWire
+{
+	// -------- PULSE LEVEL
+
+	// Length of the high phase after a low pulse.
+	// Between bits this is always Waveform::high, only the end bit differs.
+	enum class HighTime
+	{
+		regular = 0,
+		busyEnd,	// about one tick, bus kept busy for the next transmission
+		idleEnd,	// much longer than two ticks (observed ~8ms), or end of capture
+	};
+
+	constexpr
+	HighTime
+	classifyHighTime(const U64& samplesPerTick, const U64& highSamples)
+	{
+		const auto samplingOffset = samplesPerTick / 2;
+		if (highSamples <= samplesPerTick + samplingOffset)
+		{
+			return HighTime::busyEnd;
+		}
+		if (highSamples > samplesPerTick * Waveform::high + samplingOffset)
+		{
+			return HighTime::idleEnd;
+		}
+		return HighTime::regular;
+	}
+	static_assert(classifyHighTime(20, 30) == HighTime::busyEnd, "calculation is wrong?");
+	static_assert(classifyHighTime(20, 40) == HighTime::regular, "calculation is wrong?");
+	static_assert(classifyHighTime(20, 50) == HighTime::regular, "calculation is wrong?");
+	static_assert(classifyHighTime(20, 51) == HighTime::idleEnd, "calculation is wrong?");
+
+	// Accepted deviation of a low pulse from its nominal length, in ticks.
+	// 0.5 is plain rounding to the nearest tick. The end bit has the same low
+	// pulse as data0 and is only told apart by its high time, so it has no own window.
+	struct PulseTolerance
+	{
+		double start = 0.5;
+		double data1 = 0.5;
+		double data0 = 0.5;
+	};
+
+	// Low pulse length -> BitType, precomputed once.
+	// The table is indexed by the pulse length in fractions of a tick
+	// (TickClock units), so it is the same few hundred bytes at any sample rate
+	// and does not change when the clock of a unit drifts.
+	class PulseClassifier
+	{
+	public:
+		explicit PulseClassifier(const U64& unitsPerTick, const PulseTolerance& tolerance = {});
+
+		std::optional<BitType>
+		classify(const U64& lowUnits) const
+		{
+			if (lowUnits >= mTable.size())
+			{
+				// longer than any bit
+				return std::nullopt;
+			}
+			const auto entry = mTable[lowUnits];
+			if (entry == invalid)
+			{
+				return std::nullopt;
+			}
+			return static_cast<BitType>(entry);
+		}
+
+	private:
+		static constexpr U8 invalid = std::to_underlying(BitType::_num);
+
+		std::vector<U8> mTable;
+	};
+
+	// Follows the clock of the transmitting unit, which may be a few percent off
+	// and drift over time. Every start bit (11 ticks) resynchronizes the tick length,
+	// the following bits of the transmission refine it (least squares, the jitter is
+	// in samples, so long pulses tell more). Pulse lengths are converted to fractions
+	// of this tick, so the classification itself never changes.
+	class TickClock
+	{
+	public:
+		static constexpr U64 unitsPerTick = 64;
+		// anything this long is neither a bit nor a regular high
+		static constexpr U64 maxUnits = 16 * unitsPerTick;
+
+		explicit TickClock(const TickLength& nominal);
+
+		// `samples` in 1/unitsPerTick ticks, saturating at maxUnits
+		U64
+		toUnits(const U64& samples) const
+		{
+			if (samples >= mMaxSamples)
+			{
+				return maxUnits;
+			}
+			return (samples * mInverse) >> inverseShift;
+		}
+
+		// same, with the configured tick length
+		U64
+		toNominalUnits(const U64& samples) const
+		{
+			if (samples >= mMaxNominalSamples)
+			{
+				return maxUnits;
+			}
+			return (samples * mNominalInverse) >> inverseShift;
+		}
+
+		// rounded whole ticks of the nominal length, also for long durations.
+		// Word offsets are stored like this, as the results only know the nominal one.
+		U64
+		toNominalTicks(const U64& samples) const;
+
+		U64
+		toSamples(const U64& units) const
+		{
+			return (units * mTickLength.raw / unitsPerTick + TickLength::one / 2) >> TickLength::fractionBits;
+		}
+
+		// a start bit, the previous estimate only counts a little
+		void
+		resync(const U64& samples, const Ticks& ticks);
+
+		// any other bit of the transmission, counts from the next update() on
+		void
+		track(const U64& samples, const Ticks& ticks);
+
+		// two divisions, once per transmission is plenty
+		void
+		update();
+
+		const TickLength&
+		getTickLength() const
+		{
+			return mTickLength;
+		}
+
+	private:
+		static constexpr unsigned inverseShift = 40;
+		// weight (in squared ticks) of the previous estimate against a new start bit
+		static constexpr U64 priorWeight = 4 * 11 * 11;
+		// older bits of a long transmission count less from here on
+		static constexpr U64 maxTrackedWeight = 64 * 11 * 11;
+
+		const TickLength mNominal;
+		const TickLength mMin;
+		const TickLength mMax;
+		TickLength mTickLength;
+		U64 mInverse;		// unitsPerTick / mTickLength, shifted by inverseShift
+		U64 mMaxSamples;
+		const U64 mNominalInverse;
+		const U64 mMaxNominalSamples;
+		U64 mTrackedSamplesTimesTicks;	// fixed point, like TickLength
+		U64 mTrackedTicksSquared;
+	};
+
+	// Drops levels shorter than a given width, with both of their edges,
+	// so a spike on the line merges into the level around it instead of
+	// ending up as a pulse that matches nothing. Edges come out one edge late.
+	class GlitchFilter
+	{
+	public:
+		// The recordings have spikes of a sample or two, but also highs of about
+		// a fifth of a tick between two transmissions that are not glitches.
+		static constexpr double defaultWidth_ticks = 0.1;
+
+		// 0 passes everything
+		explicit GlitchFilter(const U64& minLevel_samples)
+			: mMinLevel_samples{minLevel_samples},
+			  mPendingEdge{0},
+			  mHasPendingEdge{false},
+			  mNumSuppressed{0}
+		{
+		}
+
+		bool
+		isEnabled() const
+		{
+			return mMinLevel_samples > 0;
+		}
+
+		// calls `sink(sample)` for every edge that survives
+		template<typename Sink>
+		void
+		edge(const U64& sample, Sink&& sink)
+		{
+			if (mHasPendingEdge)
+			{
+				if (sample - mPendingEdge < mMinLevel_samples)
+				{
+					// the line never really left the level before
+					mHasPendingEdge = false;
+					mNumSuppressed++;
+					return;
+				}
+				sink(mPendingEdge);
+			}
+			mPendingEdge = sample;
+			mHasPendingEdge = true;
+		}
+
+		// hands out the last edge, nothing can follow it anymore
+		template<typename Sink>
+		void
+		flush(Sink&& sink)
+		{
+			if (mHasPendingEdge)
+			{
+				mHasPendingEdge = false;
+				sink(mPendingEdge);
+			}
+		}
+
+		U64
+		getNumSuppressed() const
+		{
+			return mNumSuppressed;
+		}
+
+	private:
+		const U64 mMinLevel_samples;
+		U64 mPendingEdge;
+		bool mHasPendingEdge;
+		U64 mNumSuppressed;
+	};
+
+	enum class Marker
+	{
+		start = 0,
+		data1,
+		data0,
+		busyEnd,
+		idleEnd,
+		invalidPulse,	// low pulse did not match any waveform, transmission is dropped
+		invalidState,	// bit was not expected in the current word
+	};
+
+	// Everything the decoder finds is reported through this.
+	class DecoderListener
+	{
+	public:
+		virtual ~DecoderListener() = default;
+
+		// one per low pulse, `sample` is the center of the pulse
+		virtual void onMarker(const U64& sample, const Marker& marker, const HKWireState& state) = 0;
+		// a data carrying word (source .. data2) is complete
+		virtual void onWord(const HKWireState& /* state */, const U64& /* endOfWord */) {}
+		// a whole transmission was terminated by its end bit
+		virtual void onCommand(const CommandRecord& record) = 0;
+		// the state machine advanced to the next word
+		virtual void onAdvance(const HKWireState& /* state */) {}
+		// Capture that could not be decoded, from the start of a broken transmission
+		// up to the rising edge of its last pulse, `end - start` samples.
+		// Comes once per broken transmission, after its error marker.
+		virtual void onLost(const U64& /* start */, const U64& /* end */) {}
+	};
+
+	// SDK-independent part of the analyzer:
+	// pulse classification, HKWireState machine and frame emission.
+	class Decoder
+	{
+	public:
+		// `glitch_ticks` only applies to decode(), see GlitchFilter
+		Decoder(DecoderListener& listener, const TickLength& tickLength,
+		        const PulseTolerance& tolerance = {}, const double& glitch_ticks = 0);
+
+		// One low pulse, whose following high time is already known.
+		void
+		pulse(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime);
+
+		// Whether a low pulse of this length could be the end bit of the current transmission.
+		// Only then the following high time may be open ended (idle bus).
+		bool
+		mayBeEndBit(const U64& lowSamples) const
+		{
+			return mState.currentNumberOfBitsReceived == 0 &&
+			       isBitValidInState(mState.wordState, BitType::end) &&
+			       mClassifier.classify(mClock.toUnits(lowSamples)) == BitType::data0;
+		}
+
+		// with the tick length of the current transmission
+		HighTime
+		classifyHighTime(const U64& highSamples) const
+		{
+			return HKWire::classifyHighTime(TickClock::unitsPerTick, mClock.toUnits(highSamples));
+		}
+
+		// samples of high up to which an end bit counts as HighTime::busyEnd
+		U64
+		getBusyEndThreshold() const
+		{
+			return mClock.toSamples(TickClock::unitsPerTick + TickClock::unitsPerTick / 2);
+		}
+
+		// samples of high after which the bus counts as idle
+		U64
+		getIdleThreshold() const
+		{
+			return mClock.toSamples(TickClock::unitsPerTick * Waveform::high + TickClock::unitsPerTick / 2) + 1;
+		}
+
+		// Streaming interface, edges have to alternate.
+		// Unlike decode(), these do not go through the glitch filter.
+		// A pulse is decoded as soon as the falling edge after it is known.
+		void
+		fallingEdge(const U64& sample);
+		void
+		risingEdge(const U64& sample);
+		// The line stays idle from here on, terminates a pending pulse.
+		void
+		finish();
+
+		// Alternating edge timestamps, starting with a falling edge.
+		// May be called repeatedly for consecutive chunks of one capture.
+		void
+		decode(std::span<const U64> edges);
+
+		U64
+		getNumSuppressedGlitches() const
+		{
+			return mGlitchFilter.getNumSuppressed();
+		}
+
+		// in broken transmissions, see DecoderListener::onLost
+		U64
+		getLostSamples() const
+		{
+			return mLostSamples;
+		}
+
+		const HKWireState&
+		getState() const
+		{
+			return mState;
+		}
+
+		const TickLength&
+		getTickLength() const
+		{
+			return mClock.getTickLength();
+		}
+
+	private:
+		// After an error, nothing before the next start bit can be decoded.
+		// The pulses until then are only looked at for their length,
+		// an idle line ends the broken transmission.
+		void
+		loseSync(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime);
+		// true if the pulse was skipped
+		bool
+		skipUntilStart(const U64& fallingEdge, const U64& risingEdge, const HighTime& highTime);
+		void
+		reportLost();
+		std::optional<BitType>
+		classify(const U64& lowPulseLength);
+
+		void
+		edge(const U64& sample)
+		{
+			if (mExpectFallingEdge)
+			{
+				fallingEdge(sample);
+			}
+			else
+			{
+				risingEdge(sample);
+			}
+		}
+
+		DecoderListener& mListener;
+		TickClock mClock;
+		const PulseClassifier mClassifier;	// in TickClock units
+		GlitchFilter mGlitchFilter;
+		HKWireState mState;
+		CommandRecord::WordOffsets mWordOffsets;
+
+		U64 mPendingFallingEdge;
+		U64 mPendingRisingEdge;
+		bool mHasPendingPulse;
+		bool mExpectFallingEdge;
+
+		bool mInTransmission;	// from its start bit until its end bit
+		bool mResyncing;
+		bool mHasLostStretch;
+		U64 mLostStart;
+		U64 mLostEnd;
+		U64 mLostSamples;
+	};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "HKWire.h"
+
+#include <array>
+#include <atomic>
+
+namespace HKWire
+{
+	enum class DiagnosticKind : U8
+	{
+		invalidPulse = 0,	// low pulse did not match any waveform
+		invalidState,		// bit was not expected in the current word
+		lost,				// start of capture that could not be decoded
+	};
+
+	constexpr const char*
+	getNameOfDiagnosticKind(const DiagnosticKind& kind)
+	{
+		switch (kind)
+		{
+			case DiagnosticKind::invalidPulse:
+				return "invalid pulse";
+			case DiagnosticKind::invalidState:
+				return "invalid state";
+			case DiagnosticKind::lost:
+				return "lost";
+		}
+		return "?";
+	}
+
+	struct Diagnostic
+	{
+		U64 sample;
+		DiagnosticKind kind;
+		WordState state;	// the word that was being received, not for `lost`
+	};
+
+	// What went wrong while decoding, without any I/O on the decoding thread.
+	// One thread pushes, one thread at a time drains. Nothing is allocated after
+	// construction, so a capture full of errors costs a store each. What does not
+	// fit until the next drain is only counted.
+	template<size_t Capacity>
+	class DiagnosticsRing
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "wraps with a mask");
+
+	public:
+		static constexpr size_t capacity = Capacity;
+
+		bool
+		push(const Diagnostic& diagnostic)
+		{
+			const size_t head = mHead.load(std::memory_order_relaxed);
+			if (head - mTail.load(std::memory_order_acquire) == Capacity) [[unlikely]]
+			{
+				mNumDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			mEvents[head & (Capacity - 1)] = diagnostic;
+			mHead.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// calls `sink` with every event pushed since the last drain, oldest first
+		template<typename Sink>
+		size_t
+		drain(Sink&& sink)
+		{
+			const size_t tail = mTail.load(std::memory_order_relaxed);
+			const size_t head = mHead.load(std::memory_order_acquire);
+			for (size_t i = tail; i != head; i++)
+			{
+				sink(mEvents[i & (Capacity - 1)]);
+			}
+			mTail.store(head, std::memory_order_release);
+			return head - tail;
+		}
+
+		U64
+		getNumDropped() const
+		{
+			return mNumDropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::array<Diagnostic, Capacity> mEvents{};
+		// apart, so the two threads don't fight over one cache line
+		alignas(64) std::atomic<size_t> mHead{0};
+		alignas(64) std::atomic<size_t> mTail{0};
+		std::atomic<U64> mNumDropped{0};
+	};
+}
@@ -0,0 +1,159 @@
+#include "HKWireExport.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace HKWire;
+
+namespace
+{
+	constexpr char hexDigits[] = "0123456789ABCDEF";
+	// nanoseconds are plenty, and keep fraction * 10^decimals within 64 bit for U32 sample rates
+	constexpr unsigned maxTimeDecimals = 9;
+}
+
+ExportWriter::ExportWriter(const char* path)
+	: mFile{std::fopen(path, "wb")},
+	  mBuffer{new char[bufferSize]},
+	  mFill{0},
+	  mFailed{false}
+{
+	if (mFile != nullptr)
+	{
+		// we buffer ourselves
+		std::setvbuf(mFile, nullptr, _IONBF, 0);
+	}
+}
+
+ExportWriter::~ExportWriter()
+{
+	close();
+}
+
+void
+ExportWriter::flush()
+{
+	if (mFile != nullptr && mFill > 0 && std::fwrite(mBuffer.get(), 1, mFill, mFile) != mFill)
+	{
+		mFailed = true;
+	}
+	mFill = 0;
+}
+
+bool
+ExportWriter::close()
+{
+	if (mFile == nullptr)
+	{
+		return false;
+	}
+	flush();
+	mFailed |= std::fclose(mFile) != 0;
+	mFile = nullptr;
+	return !mFailed;
+}
+
+void
+ExportWriter::write(const void* data, size_t length)
+{
+	const auto* bytes = static_cast<const char*>(data);
+	while (length > 0)
+	{
+		if (mFill == bufferSize)
+		{
+			flush();
+		}
+		const size_t chunk = std::min(length, bufferSize - mFill);
+		std::memcpy(mBuffer.get() + mFill, bytes, chunk);
+		mFill += chunk;
+		bytes += chunk;
+		length -= chunk;
+	}
+}
+
+void
+ExportWriter::text(const char* string)
+{
+	write(string, std::strlen(string));
+}
+
+void
+ExportWriter::hex(U64 value, const unsigned& bits)
+{
+	char digits[2 + 16];
+	unsigned num = (bits + 3) / 4;
+	for (U64 rest = num < 16 ? value >> (num * 4) : 0; rest != 0 && num < 16; rest >>= 4)
+	{
+		num++;	// does not fit the bits, print all of it anyway
+	}
+	if (num == 0)
+	{
+		num = 1;
+	}
+	digits[0] = '0';
+	digits[1] = 'x';
+	for (unsigned i = num; i > 0; i--)
+	{
+		digits[1 + i] = hexDigits[value & 0xF];
+		value >>= 4;
+	}
+	write(digits, 2 + num);
+}
+
+void
+ExportWriter::decimal(U64 value)
+{
+	char digits[20];
+	unsigned pos = sizeof(digits);
+	do
+	{
+		digits[--pos] = char('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	write(digits + pos, sizeof(digits) - pos);
+}
+
+void
+ExportWriter::littleEndian(U64 value, const size_t& bytes)
+{
+	char data[sizeof(U64)];
+	for (size_t i = 0; i < bytes; i++)
+	{
+		data[i] = char(value & 0xFF);
+		value >>= 8;
+	}
+	write(data, bytes);
+}
+
+void
+ExportWriter::time(const U64& sample, const U64& trigger, const U64& sampleRate_Hz)
+{
+	U64 distance = sample - trigger;
+	if (sample < trigger)
+	{
+		put('-');
+		distance = trigger - sample;
+	}
+	decimal(distance / sampleRate_Hz);
+
+	unsigned decimals = 0;
+	U64 scale = 1;
+	while (scale < sampleRate_Hz && decimals < maxTimeDecimals)
+	{
+		scale *= 10;
+		decimals++;
+	}
+	if (decimals == 0)
+	{
+		return;
+	}
+	char digits[1 + maxTimeDecimals];
+	digits[0] = '.';
+	U64 fraction = (distance % sampleRate_Hz) * scale / sampleRate_Hz;
+	for (unsigned i = decimals; i > 0; i--)
+	{
+		digits[i] = char('0' + fraction % 10);
+		fraction /= 10;
+	}
+	write(digits, 1 + decimals);
+}
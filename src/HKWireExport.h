@@ -0,0 +1,75 @@
+#pragma once
+
+#include <LogicPublicTypes.h>
+
+#include <cstdio>
+#include <memory>
+
+namespace HKWire
+{
+	// Output file for the exports. Everything goes into one large block that is
+	// written out when full, so a row costs a few byte copies and no syscall.
+	// Numbers are formatted by hand, printf and the AnalyzerHelpers are
+	// the slowest part of an export otherwise.
+	class ExportWriter
+	{
+	public:
+		static constexpr size_t bufferSize = 1 << 20;
+
+		explicit ExportWriter(const char* path);
+		~ExportWriter();
+
+		ExportWriter(const ExportWriter&) = delete;
+		ExportWriter& operator=(const ExportWriter&) = delete;
+
+		bool
+		isOpen() const
+		{
+			return mFile != nullptr;
+		}
+
+		void
+		write(const void* data, size_t length);
+
+		void
+		put(const char& c)
+		{
+			if (mFill == bufferSize)
+			{
+				flush();
+			}
+			mBuffer[mFill++] = c;
+		}
+
+		void
+		text(const char* string);
+
+		// "0x0C", padded to the number of bits like GetNumberString does
+		void
+		hex(U64 value, const unsigned& bits);
+
+		void
+		decimal(U64 value);
+
+		// lowest `bytes` bytes of `value`, least significant first
+		void
+		littleEndian(U64 value, const size_t& bytes);
+
+		// seconds relative to `trigger`, with as many decimals as one sample needs
+		void
+		time(const U64& sample, const U64& trigger, const U64& sampleRate_Hz);
+
+		// writes out the buffer, false if anything went wrong so far
+		bool
+		close();
+
+	private:
+		void
+		flush();
+
+		std::FILE* mFile;
+		std::unique_ptr<char[]> mBuffer;
+		size_t mFill;
+		bool mFailed;
+	};
+}
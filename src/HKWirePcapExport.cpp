@@ -0,0 +1,44 @@
+#include "HKWirePcapExport.h"
+
+using namespace HKWire;
+using namespace HKWire::PcapFormat;
+
+PcapExporter::PcapExporter(ExportWriter& writer, const U64& sampleRate_Hz)
+	: mWriter{writer},
+	  mSampleRate_Hz{sampleRate_Hz}
+{
+	mWriter.littleEndian(magicNanoseconds, 4);
+	mWriter.littleEndian(versionMajor, 2);
+	mWriter.littleEndian(versionMinor, 2);
+	mWriter.littleEndian(0, 4);	// timezone, unused
+	mWriter.littleEndian(0, 4);	// accuracy, unused
+	mWriter.littleEndian(maxPacketSize, 4);
+	mWriter.littleEndian(linkTypeUser0, 4);
+}
+
+void
+PcapExporter::add(const CommandRecord& record)
+{
+	const auto& payload = record.payload;
+	U8 packet[maxPacketSize];
+	U32 length = 0;
+	packet[length++] = U8(payload.source << 4 | payload.dest);
+	packet[length++] = payload.command;
+	if (payload.data1.has_value())
+	{
+		packet[length++] = *payload.data1;
+	}
+	if (payload.data2.has_value())
+	{
+		packet[length++] = *payload.data2;
+	}
+
+	// the remainder is below the sample rate, so this does not overflow
+	const U64 seconds = record.start / mSampleRate_Hz;
+	const U64 nanoseconds = (record.start % mSampleRate_Hz) * 1000000000 / mSampleRate_Hz;
+	mWriter.littleEndian(seconds, 4);
+	mWriter.littleEndian(nanoseconds, 4);
+	mWriter.littleEndian(length, 4);	// captured
+	mWriter.littleEndian(length, 4);	// original
+	mWriter.write(packet, length);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "HKWireExport.h"
+#include "HKWireRecord.h"
+
+namespace HKWire
+{
+	// Commands as pcap file, one packet per command, for the usual packet tools.
+	// Nanosecond pcap (magic a1b23c4d), link type USER0 (147).
+	// Timestamps are the start of the command, counted from the start of the capture.
+	//
+	// Packet layout, as on the wire:
+	//   U8 source << 4 | dest, U8 command, [U8 data1, [U8 data2]]
+	//
+	// A Wireshark dissector needs to be told what USER0 is,
+	// e.g. in "DLT_User" as "hkwire" with a small lua dissector.
+	namespace PcapFormat
+	{
+		constexpr U32 magicNanoseconds = 0xA1B23C4D;
+		constexpr U16 versionMajor = 2;
+		constexpr U16 versionMinor = 4;
+		constexpr U32 linkTypeUser0 = 147;
+		constexpr U32 maxPacketSize = 4;
+	}
+
+	class PcapExporter
+	{
+	public:
+		// writes the file header right away
+		PcapExporter(ExportWriter& writer, const U64& sampleRate_Hz);
+
+		void
+		add(const CommandRecord& record);
+
+	private:
+		ExportWriter& mWriter;
+		const U64 mSampleRate_Hz;
+	};
+}
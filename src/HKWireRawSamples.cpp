@@ -0,0 +1,192 @@
+#include "HKWireRawSamples.h"
+
+#include <bit>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HKWIRE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace HKWire;
+
+namespace
+{
+	constexpr unsigned samplesPerWord = 64;
+
+	inline U64
+	getTransitions(const U64& word, const U64& carry)
+	{
+		return word ^ ((word << 1) | carry);
+	}
+
+	size_t
+	skipQuietScalar(const U64* words, size_t count, U64 carry)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (getTransitions(words[i], carry) != 0)
+			{
+				return i;
+			}
+			carry = words[i] >> (samplesPerWord - 1);
+		}
+		return count;
+	}
+
+#ifdef HKWIRE_X86_KERNELS
+	// The first word needs the carry, every other one takes it from the word before.
+	__attribute__((target("sse4.1")))
+	size_t
+	skipQuietSse41(const U64* words, size_t count, U64 carry)
+	{
+		if (count == 0 || getTransitions(words[0], carry) != 0)
+		{
+			return 0;
+		}
+		size_t i = 1;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+			const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i - 1));
+			const __m128i shifted = _mm_or_si128(_mm_slli_epi64(current, 1), _mm_srli_epi64(previous, samplesPerWord - 1));
+			const __m128i transitions = _mm_xor_si128(current, shifted);
+			if (!_mm_testz_si128(transitions, transitions))
+			{
+				break;
+			}
+		}
+		return i + skipQuietScalar(words + i, count - i, words[i - 1] >> (samplesPerWord - 1));
+	}
+
+	__attribute__((target("avx2")))
+	size_t
+	skipQuietAvx2(const U64* words, size_t count, U64 carry)
+	{
+		if (count == 0 || getTransitions(words[0], carry) != 0)
+		{
+			return 0;
+		}
+		size_t i = 1;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+			const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i - 1));
+			const __m256i shifted = _mm256_or_si256(_mm256_slli_epi64(current, 1),
+			                                        _mm256_srli_epi64(previous, samplesPerWord - 1));
+			const __m256i transitions = _mm256_xor_si256(current, shifted);
+			if (!_mm256_testz_si256(transitions, transitions))
+			{
+				break;
+			}
+		}
+		return i + skipQuietScalar(words + i, count - i, words[i - 1] >> (samplesPerWord - 1));
+	}
+#endif
+}
+
+EdgeExtractor::Kernel
+EdgeExtractor::getBestKernel()
+{
+#ifdef HKWIRE_X86_KERNELS
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return Kernel::avx2;
+	}
+	if (__builtin_cpu_supports("sse4.1"))
+	{
+		return Kernel::sse41;
+	}
+#endif
+	return Kernel::scalar;
+}
+
+const char*
+EdgeExtractor::getNameOfKernel(const Kernel& kernel)
+{
+	switch (kernel)
+	{
+		case Kernel::sse41:
+			return "sse4.1";
+		case Kernel::avx2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+EdgeExtractor::EdgeExtractor(const std::optional<Kernel>& kernel)
+	: mKernel{kernel.value_or(getBestKernel())},
+	  mSkipQuiet{skipQuietScalar},
+	  mNumSamples{0},
+	  mCarry{0},
+	  mInitialLevel{true}
+{
+#ifdef HKWIRE_X86_KERNELS
+	// a kernel the CPU doesn't have would crash, the scalar one is still right
+	if (mKernel == Kernel::avx2 && __builtin_cpu_supports("avx2"))
+	{
+		mSkipQuiet = skipQuietAvx2;
+	}
+	else if (mKernel == Kernel::sse41 && __builtin_cpu_supports("sse4.1"))
+	{
+		mSkipQuiet = skipQuietSse41;
+	}
+	else
+#endif
+	{
+		mKernel = Kernel::scalar;
+	}
+}
+
+void
+EdgeExtractor::extract(std::span<const U64> words, const U64& numSamples, std::vector<U64>& edges)
+{
+	if (numSamples == 0 || words.empty())
+	{
+		return;
+	}
+	if (mNumSamples == 0)
+	{
+		// nothing before the first sample to compare with
+		mInitialLevel = words[0] & 1;
+		mCarry = words[0] & 1;
+	}
+	const size_t numFullWords = std::min<size_t>(numSamples / samplesPerWord, words.size());
+	for (size_t i = 0; i < numFullWords; i++)
+	{
+		i += mSkipQuiet(words.data() + i, numFullWords - i, mCarry);
+		if (i == numFullWords)
+		{
+			break;
+		}
+		// where the skipping stopped, there is an edge
+		if (i > 0)
+		{
+			mCarry = words[i - 1] >> (samplesPerWord - 1);
+		}
+		const U64 base = mNumSamples + i * samplesPerWord;
+		for (U64 transitions = getTransitions(words[i], mCarry); transitions != 0; transitions &= transitions - 1)
+		{
+			edges.push_back(base + unsigned(std::countr_zero(transitions)));
+		}
+		mCarry = words[i] >> (samplesPerWord - 1);
+	}
+	if (numFullWords > 0)
+	{
+		mCarry = words[numFullWords - 1] >> (samplesPerWord - 1);
+	}
+	mNumSamples += numFullWords * samplesPerWord;
+
+	const unsigned rest = unsigned(std::min<U64>(numSamples - numFullWords * samplesPerWord, samplesPerWord));
+	if (rest > 0 && numFullWords < words.size())
+	{
+		const U64 word = words[numFullWords];
+		const U64 valid = rest == samplesPerWord ? ~U64(0) : (U64(1) << rest) - 1;
+		for (U64 transitions = getTransitions(word, mCarry) & valid; transitions != 0; transitions &= transitions - 1)
+		{
+			edges.push_back(mNumSamples + unsigned(std::countr_zero(transitions)));
+		}
+		mCarry = (word >> (rest - 1)) & 1;
+		mNumSamples += rest;
+	}
+}
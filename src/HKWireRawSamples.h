@@ -0,0 +1,70 @@
+#pragma once
+
+#include <LogicPublicTypes.h>
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace HKWire
+{
+	// Finds the edges in a raw recording of one channel, packed one bit per sample,
+	// least significant bit first (which makes it little endian 64 bit words).
+	//
+	// A word has a transition where it differs from itself shifted by one sample.
+	// Almost all words of a HKWire recording have none, so these are skipped several
+	// at a time with AVX2 or SSE4.1 if the CPU has them, which keeps up with the
+	// memory. Words with edges cost a count trailing zeros per edge.
+	class EdgeExtractor
+	{
+	public:
+		enum class Kernel
+		{
+			scalar,
+			sse41,
+			avx2,
+		};
+
+		// the best the CPU can do, unless a kernel is forced
+		explicit EdgeExtractor(const std::optional<Kernel>& kernel = std::nullopt);
+
+		// Appends the sample numbers of the transitions in the next `numSamples` samples
+		// to `edges`. All words but the last have to be full. The first sample only sets the level.
+		void
+		extract(std::span<const U64> words, const U64& numSamples, std::vector<U64>& edges);
+
+		// level of the first sample, once there was one
+		bool
+		getInitialLevel() const
+		{
+			return mInitialLevel;
+		}
+
+		U64
+		getNumSamples() const
+		{
+			return mNumSamples;
+		}
+
+		Kernel
+		getKernel() const
+		{
+			return mKernel;
+		}
+
+		static Kernel
+		getBestKernel();
+
+		static const char*
+		getNameOfKernel(const Kernel& kernel);
+
+	private:
+		Kernel mKernel;
+		// number of leading words in `words[0, count)` without an edge,
+		// `carry` is the last sample before them in bit 0
+		size_t (*mSkipQuiet)(const U64* words, size_t count, U64 carry);
+		U64 mNumSamples;
+		U64 mCarry;
+		bool mInitialLevel;
+	};
+}
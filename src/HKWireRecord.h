@@ -0,0 +1,94 @@
+#pragma once
+
+#include "HKWire.h"
+
+namespace HKWire
+{
+	// One decoded transmission: payload plus where its words are.
+	// Word, command and text views are all derived from this,
+	// so the decoding does not depend on how it is presented.
+	struct CommandRecord
+	{
+		U64 start;	// falling edge of the start bit
+		U64 end;	// one tick after the end bit
+		Payload payload;
+
+		// start of each word, in whole ticks after `start`
+		using WordOffsets = std::array<U16, std::to_underlying(WordState::_num)>;
+		WordOffsets wordOffsets_ticks;
+
+		static constexpr unsigned bitsPerPackedOffset = 10;
+		static constexpr U16 maxOffset_ticks = (1 << bitsPerPackedOffset) - 1;
+		static_assert(maxOffset_ticks > (maxLowTicks + Waveform::high) * getMaxBitsPerTransmission(),
+		              "offsets of a complete transmission need to fit");
+		// WordState::start is always at offset zero and not packed
+		static_assert((std::to_underlying(WordState::_num) - 1) * bitsPerPackedOffset <= 64,
+		              "packed offsets need to fit into a U64");
+
+		// samples from `start` to the start of `word`
+		constexpr
+		U64
+		getOffsetOfWord(const WordState& word, const TickLength& tickLength) const
+		{
+			// rounded only once, whole samples per tick would be far off at low sample rates
+			return (wordOffsets_ticks[std::to_underlying(word)] * tickLength.raw + TickLength::one / 2) >>
+			       TickLength::fractionBits;
+		}
+
+		constexpr
+		U64
+		getStartOfWord(const WordState& word, const TickLength& tickLength) const
+		{
+			return start + getOffsetOfWord(word, tickLength);
+		}
+
+		// the last sample belonging to `word`, which is where its last bit ends
+		constexpr
+		U64
+		getEndOfWord(const WordState& word, const TickLength& tickLength) const
+		{
+			if (word == WordState::end)
+			{
+				return end;
+			}
+			auto next = static_cast<WordState>(std::to_underlying(word) + 1);
+			if (next == WordState::data1 && !payload.data1.has_value())
+			{
+				next = WordState::end;
+			}
+			else if (next == WordState::data2 && !payload.data2.has_value())
+			{
+				next = WordState::end;
+			}
+			// the next word starts with a falling edge after a two tick high
+			return getStartOfWord(next, tickLength) -
+			       (((Waveform::high - 1) * tickLength.raw + TickLength::one / 2) >> TickLength::fractionBits);
+		}
+
+		constexpr
+		U64
+		getPackedWordOffsets() const
+		{
+			U64 packed = 0;
+			for (auto i = std::to_underlying(WordState::source); i < std::to_underlying(WordState::_num); i++)
+			{
+				packed |= U64(wordOffsets_ticks[i] & maxOffset_ticks) << ((i - 1) * bitsPerPackedOffset);
+			}
+			return packed;
+		}
+
+		static constexpr
+		WordOffsets
+		unpackWordOffsets(const U64& packed)
+		{
+			WordOffsets offsets{};
+			for (auto i = std::to_underlying(WordState::source); i < std::to_underlying(WordState::_num); i++)
+			{
+				offsets[i] = (packed >> ((i - 1) * bitsPerPackedOffset)) & maxOffset_ticks;
+			}
+			return offsets;
+		}
+	};
+	static_assert(CommandRecord::unpackWordOffsets(CommandRecord{0, 0, {}, {0, 13, 50, 87, 160, 233, 306}}.getPackedWordOffsets())
+	              == CommandRecord::WordOffsets{0, 13, 50, 87, 160, 233, 306}, "packing is wrong?");
+}
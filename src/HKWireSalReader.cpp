@@ -0,0 +1,534 @@
+// 64 bit offsets for fseeko / ftello on 32 bit platforms as well, before any system header
+#define _FILE_OFFSET_BITS 64
+
+#include "HKWireSalReader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+using namespace HKWire;
+
+namespace
+{
+	template<typename T>
+	T
+	fromLittleEndian(const U8* bytes)
+	{
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); i++)
+		{
+			value |= T(bytes[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	constexpr U32 endOfCentralDirectorySignature = 0x06054b50;
+	constexpr U32 centralDirectorySignature = 0x02014b50;
+	constexpr U32 localHeaderSignature = 0x04034b50;
+	constexpr size_t endOfCentralDirectorySize = 22;
+	constexpr size_t centralDirectoryEntrySize = 46;
+	constexpr size_t localHeaderSize = 30;
+	constexpr U16 methodStored = 0;
+	constexpr U16 methodDeflate = 8;
+
+	// Zip64, for archives or entries past 4 GiB. The 32 bit fields are all ones
+	// then, and the real values are in these records.
+	constexpr U32 zip64EndOfCentralDirectorySignature = 0x06064b50;
+	constexpr U32 zip64LocatorSignature = 0x07064b50;
+	constexpr size_t zip64EndOfCentralDirectorySize = 56;
+	constexpr size_t zip64LocatorSize = 20;
+	constexpr U16 zip64ExtraFieldId = 0x0001;
+	constexpr U32 zip64Marker32 = 0xFFFFFFFF;
+	constexpr U16 zip64Marker16 = 0xFFFF;
+
+	bool
+	seekTo(std::FILE* file, const U64& offset)
+	{
+#ifdef _WIN32
+		return offset <= U64(INT64_MAX) && _fseeki64(file, __int64(offset), SEEK_SET) == 0;
+#else
+		return offset <= U64(std::numeric_limits<off_t>::max()) && fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+	}
+
+	bool
+	skip(std::FILE* file, const U64& length)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, __int64(length), SEEK_CUR) == 0;
+#else
+		return fseeko(file, off_t(length), SEEK_CUR) == 0;
+#endif
+	}
+
+	std::optional<U64>
+	getFileSize(std::FILE* file)
+	{
+#ifdef _WIN32
+		if (_fseeki64(file, 0, SEEK_END) != 0)
+		{
+			return std::nullopt;
+		}
+		const __int64 size = _ftelli64(file);
+#else
+		if (fseeko(file, 0, SEEK_END) != 0)
+		{
+			return std::nullopt;
+		}
+		const off_t size = ftello(file);
+#endif
+		if (size < 0)
+		{
+			return std::nullopt;
+		}
+		return U64(size);
+	}
+
+	// The zip64 extra field of a central directory entry has the values whose
+	// 32 bit field is all ones, in this order. False if one is missing.
+	bool
+	readZip64Extra(const U8* extra, const size_t& extraLength, U64& uncompressedSize, U64& compressedSize,
+	               U64& localHeaderOffset)
+	{
+		size_t position = 0;
+		while (position + 4 <= extraLength)
+		{
+			const U16 id = fromLittleEndian<U16>(extra + position);
+			const U16 length = fromLittleEndian<U16>(extra + position + 2);
+			const U8* field = extra + position + 4;
+			position += 4 + length;
+			if (position > extraLength)
+			{
+				break;
+			}
+			if (id != zip64ExtraFieldId)
+			{
+				continue;
+			}
+			size_t offset = 0;
+			for (U64* value : {&uncompressedSize, &compressedSize, &localHeaderOffset})
+			{
+				if (*value != zip64Marker32)
+				{
+					continue;
+				}
+				if (offset + sizeof(U64) > length)
+				{
+					return false;
+				}
+				*value = fromLittleEndian<U64>(field + offset);
+				offset += sizeof(U64);
+			}
+			return true;
+		}
+		return uncompressedSize != zip64Marker32 && compressedSize != zip64Marker32 &&
+		       localHeaderOffset != zip64Marker32;
+	}
+
+	constexpr char channelMagic[] = "<SALEAE>";
+	constexpr U32 channelVersion = 1;
+	constexpr U32 channelTypeDigital = 100;
+	constexpr size_t blockHeaderSize = 1 + 3 * sizeof(U64) + 15;
+	constexpr size_t blockRecordSize = 20;
+	constexpr size_t blockRecordLevelOffset = 16;
+	// a block spans 2000 units, even a megahertz square wave stays far below this
+	constexpr U64 maxRunBytes = 1 << 28;
+}
+
+// One zip entry, inflated chunk by chunk into a small window.
+struct SalReader::Inflater
+{
+	static constexpr size_t chunkSize = 1 << 16;
+
+	std::FILE* file;
+	U16 method;
+	U64 compressedLeft;
+	z_stream stream{};
+	bool initialized = false;
+	bool finished = false;
+	std::unique_ptr<U8[]> input{new U8[chunkSize]};
+	std::unique_ptr<U8[]> output{new U8[chunkSize]};
+	size_t outputPosition = 0;
+	size_t outputFill = 0;
+
+	Inflater(std::FILE* file_, const U16& method_, const U64& compressedSize)
+		: file{file_}, method{method_}, compressedLeft{compressedSize}
+	{
+		if (method == methodDeflate)
+		{
+			// raw deflate, zip has its own header
+			initialized = inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+		}
+	}
+
+	~Inflater()
+	{
+		if (initialized)
+		{
+			inflateEnd(&stream);
+		}
+	}
+
+	size_t
+	readCompressed(U8* data, const size_t& length)
+	{
+		const size_t wanted = size_t(std::min<U64>(length, compressedLeft));
+		const size_t read = std::fread(data, 1, wanted, file);
+		compressedLeft -= read;
+		return read;
+	}
+
+	// false at the end of the entry or if it is broken
+	bool
+	refill()
+	{
+		outputPosition = 0;
+		outputFill = 0;
+		if (finished)
+		{
+			return false;
+		}
+		if (method == methodStored)
+		{
+			outputFill = readCompressed(output.get(), chunkSize);
+			finished = outputFill == 0;
+			return !finished;
+		}
+		if (!initialized)
+		{
+			return false;
+		}
+		while (outputFill == 0)
+		{
+			if (stream.avail_in == 0)
+			{
+				stream.next_in = input.get();
+				stream.avail_in = uInt(readCompressed(input.get(), chunkSize));
+			}
+			stream.next_out = output.get();
+			stream.avail_out = uInt(chunkSize);
+			const int result = inflate(&stream, Z_NO_FLUSH);
+			outputFill = chunkSize - stream.avail_out;
+			if (result == Z_STREAM_END)
+			{
+				finished = true;
+				break;
+			}
+			if ((result != Z_OK && result != Z_BUF_ERROR) || (outputFill == 0 && stream.avail_in == 0))
+			{
+				// broken, or truncated
+				finished = true;
+				break;
+			}
+		}
+		return outputFill > 0;
+	}
+};
+
+SalReader::SalReader(const char* path, const unsigned& channel)
+	: mFile{std::fopen(path, "rb")},
+	  mError{},
+	  mInflater{},
+	  mSampleRate_Hz{0},
+	  mInitialLevel{true},
+	  mLevel{true},
+	  mNumBlocks{0},
+	  mNumBlocksRead{0},
+	  mRuns{}
+{
+	if (mFile == nullptr)
+	{
+		fail(std::strerror(errno));
+		return;
+	}
+	if (openEntry(channel))
+	{
+		readHeader();
+	}
+}
+
+SalReader::~SalReader()
+{
+	mInflater.reset();
+	if (mFile != nullptr)
+	{
+		std::fclose(mFile);
+	}
+}
+
+bool
+SalReader::fail(const std::string& error)
+{
+	if (mError.empty())
+	{
+		mError = error;
+	}
+	return false;
+}
+
+bool
+SalReader::openEntry(const unsigned& channel)
+{
+	// The end of central directory record is last, behind a comment of up to 64k.
+	// With zip64, its locator comes right before it.
+	const auto fileSize = getFileSize(mFile);
+	if (!fileSize.has_value())
+	{
+		return fail("not seekable");
+	}
+	const U64 tailSize = std::min<U64>(*fileSize, zip64LocatorSize + endOfCentralDirectorySize + 0xFFFF);
+	std::vector<U8> tail(tailSize);
+	if (tailSize < endOfCentralDirectorySize || !seekTo(mFile, *fileSize - tailSize) ||
+	    std::fread(tail.data(), 1, tail.size(), mFile) != tail.size())
+	{
+		return fail("not a zip archive");
+	}
+	const U8* end = nullptr;
+	for (size_t i = tail.size() - endOfCentralDirectorySize + 1; i-- > 0;)
+	{
+		if (fromLittleEndian<U32>(&tail[i]) == endOfCentralDirectorySignature)
+		{
+			end = &tail[i];
+			break;
+		}
+	}
+	if (end == nullptr)
+	{
+		return fail("not a zip archive");
+	}
+	U64 numEntries = fromLittleEndian<U16>(end + 10);
+	U64 directorySize = fromLittleEndian<U32>(end + 12);
+	U64 directoryOffset = fromLittleEndian<U32>(end + 16);
+	if (numEntries == zip64Marker16 || directorySize == zip64Marker32 || directoryOffset == zip64Marker32)
+	{
+		const U8* locator = end - std::min<size_t>(end - tail.data(), zip64LocatorSize);
+		if (end - locator != zip64LocatorSize || fromLittleEndian<U32>(locator) != zip64LocatorSignature)
+		{
+			return fail("broken zip64 archive");
+		}
+		U8 zip64End[zip64EndOfCentralDirectorySize];
+		if (!seekTo(mFile, fromLittleEndian<U64>(locator + 8)) ||
+		    std::fread(zip64End, 1, sizeof(zip64End), mFile) != sizeof(zip64End) ||
+		    fromLittleEndian<U32>(zip64End) != zip64EndOfCentralDirectorySignature)
+		{
+			return fail("broken zip64 archive");
+		}
+		numEntries = fromLittleEndian<U64>(zip64End + 32);
+		directorySize = fromLittleEndian<U64>(zip64End + 40);
+		directoryOffset = fromLittleEndian<U64>(zip64End + 48);
+	}
+
+	// a few entries of a hundred bytes, more is not a capture
+	if (directorySize > *fileSize || directorySize > (U64(1) << 24))
+	{
+		return fail("broken zip directory");
+	}
+	std::vector<U8> directory(directorySize);
+	if (!seekTo(mFile, directoryOffset) ||
+	    std::fread(directory.data(), 1, directory.size(), mFile) != directory.size())
+	{
+		return fail("broken zip directory");
+	}
+	const std::string wanted = "digital-" + std::to_string(channel) + ".bin";
+	size_t position = 0;
+	for (U64 entry = 0; entry < numEntries; entry++)
+	{
+		if (position + centralDirectoryEntrySize > directory.size() ||
+		    fromLittleEndian<U32>(&directory[position]) != centralDirectorySignature)
+		{
+			return fail("broken zip directory");
+		}
+		const U8* header = &directory[position];
+		const U16 nameLength = fromLittleEndian<U16>(header + 28);
+		const size_t entrySize = centralDirectoryEntrySize + nameLength + fromLittleEndian<U16>(header + 30) +
+		                         fromLittleEndian<U16>(header + 32);
+		if (position + entrySize > directory.size())
+		{
+			return fail("broken zip directory");
+		}
+		const std::string name(reinterpret_cast<const char*>(header + centralDirectoryEntrySize), nameLength);
+		if (name == wanted)
+		{
+			const U16 method = fromLittleEndian<U16>(header + 10);
+			U64 compressedSize = fromLittleEndian<U32>(header + 20);
+			U64 uncompressedSize = fromLittleEndian<U32>(header + 24);
+			U64 localHeaderOffset = fromLittleEndian<U32>(header + 42);
+			if (method != methodStored && method != methodDeflate)
+			{
+				return fail(wanted + ": unsupported compression");
+			}
+			if (!readZip64Extra(header + centralDirectoryEntrySize + nameLength, fromLittleEndian<U16>(header + 30),
+			                    uncompressedSize, compressedSize, localHeaderOffset))
+			{
+				return fail(wanted + ": broken zip64 entry");
+			}
+			// the local header may have a different extra field
+			U8 local[localHeaderSize];
+			if (!seekTo(mFile, localHeaderOffset) ||
+			    std::fread(local, 1, sizeof(local), mFile) != sizeof(local) ||
+			    fromLittleEndian<U32>(local) != localHeaderSignature ||
+			    !skip(mFile, U64(fromLittleEndian<U16>(local + 26)) + fromLittleEndian<U16>(local + 28)))
+			{
+				return fail(wanted + ": broken zip entry");
+			}
+			mInflater = std::make_unique<Inflater>(mFile, method, compressedSize);
+			return true;
+		}
+		position += entrySize;
+	}
+	return fail("no channel " + std::to_string(channel) + " in this capture");
+}
+
+bool
+SalReader::readBytes(void* data, size_t length)
+{
+	auto* out = static_cast<U8*>(data);
+	while (length > 0)
+	{
+		auto& inflater = *mInflater;
+		if (inflater.outputPosition == inflater.outputFill && !inflater.refill())
+		{
+			return fail("capture ends early");
+		}
+		const size_t chunk = std::min(length, inflater.outputFill - inflater.outputPosition);
+		std::memcpy(out, &inflater.output[inflater.outputPosition], chunk);
+		inflater.outputPosition += chunk;
+		out += chunk;
+		length -= chunk;
+	}
+	return true;
+}
+
+bool
+SalReader::readU64(U64& value)
+{
+	U8 bytes[sizeof(U64)];
+	if (!readBytes(bytes, sizeof(bytes)))
+	{
+		return false;
+	}
+	value = fromLittleEndian<U64>(bytes);
+	return true;
+}
+
+bool
+SalReader::readHeader()
+{
+	U8 header[8 + 2 * sizeof(U32) + 1 + sizeof(double) + 18];
+	if (!readBytes(header, sizeof(header)) || !readU64(mNumBlocks))
+	{
+		return false;
+	}
+	if (std::memcmp(header, channelMagic, 8) != 0)
+	{
+		return fail("not a Logic channel file");
+	}
+	if (fromLittleEndian<U32>(header + 8) != channelVersion || fromLittleEndian<U32>(header + 12) != channelTypeDigital)
+	{
+		return fail("unsupported channel file version");
+	}
+	mInitialLevel = header[16] != 0;
+	mLevel = mInitialLevel;
+	mSampleRate_Hz = U64(std::bit_cast<double>(fromLittleEndian<U64>(header + 17)) + 0.5);
+	if (mSampleRate_Hz == 0)
+	{
+		return fail("no sample rate");
+	}
+	return true;
+}
+
+bool
+SalReader::read(std::vector<U64>& edges)
+{
+	edges.clear();
+	while (edges.empty() && mNumBlocksRead < mNumBlocks && isOpen())
+	{
+		U8 header[blockHeaderSize];
+		U64 numRunBytes;
+		if (!readBytes(header, sizeof(header)) || !readU64(numRunBytes))
+		{
+			return false;
+		}
+		const U64 begin = fromLittleEndian<U64>(header + 1);
+		const U64 end = fromLittleEndian<U64>(header + 9);
+		if (header[0] != 0 || end <= begin || numRunBytes > maxRunBytes)
+		{
+			return fail("broken block");
+		}
+		mRuns.resize(size_t(numRunBytes));
+		U64 numRecords;
+		if (!readBytes(mRuns.data(), mRuns.size()) || !readU64(numRecords))
+		{
+			return false;
+		}
+		// the level is only known after the runs
+		bool level = mLevel;
+		for (U64 i = 0; i < numRecords; i++)
+		{
+			U8 record[blockRecordSize];
+			if (!readBytes(record, sizeof(record)))
+			{
+				return false;
+			}
+			if (i == 0)
+			{
+				level = fromLittleEndian<U32>(record + blockRecordLevelOffset) != 0;
+			}
+		}
+		mNumBlocksRead++;
+
+		// relative to the block first, its samples per unit are known after the last run
+		if (level != mLevel)
+		{
+			edges.push_back(0);
+		}
+		U64 offset = 0;
+		for (size_t i = 0; i < mRuns.size();)
+		{
+			const U8 first = mRuns[i++];
+			if (first & 0x80)
+			{
+				return fail("broken run length");
+			}
+			U64 run = first & 0x3F;
+			if (first & 0x40)
+			{
+				U8 next;
+				do
+				{
+					if (i == mRuns.size())
+					{
+						return fail("broken run length");
+					}
+					next = mRuns[i++];
+					run = (run << 7) | (next & 0x7F);
+				}
+				while (next & 0x80);
+			}
+			offset += run + 1;
+			if (i < mRuns.size())
+			{
+				edges.push_back(offset);
+			}
+		}
+		const U64 units = end - begin;
+		if (offset % units != 0)
+		{
+			return fail("broken block");
+		}
+		const U64 blockStart = begin * (offset / units);
+		for (auto& edge : edges)
+		{
+			edge += blockStart;
+		}
+		mLevel = edges.size() % 2 == 0 ? mLevel : !mLevel;
+	}
+	return !edges.empty();
+}
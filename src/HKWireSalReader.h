@@ -0,0 +1,98 @@
+#pragma once
+
+#include <LogicPublicTypes.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace HKWire
+{
+	// Reads the edges of one digital channel straight out of a Logic 2 capture (.sal),
+	// without Logic and without unpacking it first.
+	//
+	// A capture is a zip archive with a `digital-N.bin` per channel. That file is
+	// inflated while it is read, and only one block of it is held at a time,
+	// so memory does not grow with the capture. Captures past 4 GiB are zip64,
+	// offsets are 64 bit throughout.
+	//
+	// The channel files are undocumented, this is what the captures in doc/captures have
+	// (little endian throughout):
+	//   "<SALEAE>", U32 version (1), U32 type (100, digital)
+	//   U8 initial level, double sample rate, 18 bytes unknown, U64 number of blocks
+	// and per block:
+	//   U8 0, U64 begin, U64 end (in units of the block's samples per unit), U64 unknown,
+	//   15 bytes unknown, U64 length of the run lengths, the run lengths,
+	//   U64 number of 20 byte records, the records (U32 level at the start of the block at 16).
+	// A run length is one byte of 6 bits, continued by big endian 7 bit groups
+	// while bit 6 (then bit 7) is set, plus one. Every run but the last ends in an edge.
+	class SalReader
+	{
+	public:
+		SalReader(const char* path, const unsigned& channel);
+		~SalReader();
+
+		SalReader(const SalReader&) = delete;
+		SalReader& operator=(const SalReader&) = delete;
+
+		// false with the reason in getError(), also after a broken block
+		bool
+		isOpen() const
+		{
+			return mError.empty();
+		}
+
+		const std::string&
+		getError() const
+		{
+			return mError;
+		}
+
+		U64
+		getSampleRate_Hz() const
+		{
+			return mSampleRate_Hz;
+		}
+
+		// level before the first edge
+		bool
+		isInitialLow() const
+		{
+			return !mInitialLevel;
+		}
+
+		// Replaces `edges` with the sample numbers of the next block(s) that have any,
+		// false once the capture is through (or broken).
+		bool
+		read(std::vector<U64>& edges);
+
+	private:
+		bool
+		openEntry(const unsigned& channel);
+		bool
+		readHeader();
+
+		// inflated bytes of the channel file
+		bool
+		readBytes(void* data, size_t length);
+		bool
+		readU64(U64& value);
+
+		bool
+		fail(const std::string& error);
+
+		std::FILE* mFile;
+		std::string mError;
+
+		struct Inflater;
+		std::unique_ptr<Inflater> mInflater;
+
+		U64 mSampleRate_Hz;
+		bool mInitialLevel;
+		bool mLevel;
+		U64 mNumBlocks;
+		U64 mNumBlocksRead;
+		std::vector<U8> mRuns;	// of the current block
+	};
+}
@@ -0,0 +1,186 @@
+#include "HKWireSegments.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <cmath>
+#include <thread>
+#include <variant>
+
+using namespace HKWire;
+
+namespace
+{
+	struct WordEvent
+	{
+		HKWireState state;
+		U64 endOfWord;
+	};
+
+	struct LostEvent
+	{
+		U64 start;
+		U64 end;
+	};
+
+	using Event = std::variant<WordEvent, CommandRecord, LostEvent>;
+
+	// Everything a segment found, to be passed on in order later.
+	class SegmentRecorder : public DecoderListener
+	{
+	public:
+		// before this, it is only warming up
+		U64 begin = 0;
+
+		void
+		onMarker(const U64&, const Marker&, const HKWireState&) override
+		{
+		}
+
+		void
+		onWord(const HKWireState& state, const U64& endOfWord) override
+		{
+			if (state.startOfTransmission >= begin)
+			{
+				events.emplace_back(WordEvent{state, endOfWord});
+			}
+		}
+
+		void
+		onCommand(const CommandRecord& record) override
+		{
+			if (record.start >= begin)
+			{
+				events.emplace_back(record);
+			}
+		}
+
+		void
+		onLost(const U64& start, const U64& end) override
+		{
+			if (start >= begin)
+			{
+				events.emplace_back(LostEvent{start, end});
+				lostSamples += end - start;
+			}
+		}
+
+		void
+		replay(DecoderListener& listener) const
+		{
+			for (const auto& event : events)
+			{
+				if (const auto* word = std::get_if<WordEvent>(&event))
+				{
+					listener.onWord(word->state, word->endOfWord);
+				}
+				else if (const auto* record = std::get_if<CommandRecord>(&event))
+				{
+					listener.onCommand(*record);
+				}
+				else
+				{
+					const auto& lost = std::get<LostEvent>(event);
+					listener.onLost(lost.start, lost.end);
+				}
+			}
+		}
+
+		std::vector<Event> events;
+		U64 numSuppressedGlitches = 0;
+		U64 lostSamples = 0;
+	};
+}
+
+SegmentedDecoder::SegmentedDecoder(const TickLength& tickLength, const PulseTolerance& tolerance,
+                                   const double& glitch_ticks, const double& split_ticks,
+                                   const unsigned& numThreads)
+	: mTickLength{tickLength},
+	  mTolerance{tolerance},
+	  mGlitch_ticks{glitch_ticks},
+	  mSplit_samples{U64(std::llround(std::max(split_ticks, minSplit_ticks) * tickLength.raw / TickLength::one))},
+	  mNumThreads{numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency())},
+	  mNumSuppressedGlitches{0},
+	  mLostSamples{0},
+	  mNumSegments{0}
+{
+}
+
+std::vector<SegmentedDecoder::Segment>
+SegmentedDecoder::split(std::span<const U64> edges) const
+{
+	// Not too many segments, every one costs a decoder and its events.
+	const size_t minEdges = std::max(minEdgesPerSegment, edges.size() / (size_t(mNumThreads) * 16));
+	std::vector<Segment> segments{Segment{0, 0, edges.size()}};
+	// the gaps since the latest one at least warmUpEdges back
+	std::deque<size_t> warmUps{0};
+	// edges[i] is a rising one for odd i, the high after it ends at edges[i + 1]
+	for (size_t i = 1; i + 1 < edges.size(); i += 2)
+	{
+		if (edges[i + 1] - edges[i] <= mSplit_samples)
+		{
+			continue;
+		}
+		const size_t gap = i + 1;
+		while (warmUps.size() > 1 && warmUps[1] + warmUpEdges <= gap)
+		{
+			warmUps.pop_front();
+		}
+		if (gap - segments.back().begin >= minEdges)
+		{
+			segments.back().end = gap;
+			segments.push_back(Segment{warmUps.front(), gap, edges.size()});
+		}
+		warmUps.push_back(gap);
+	}
+	return segments;
+}
+
+void
+SegmentedDecoder::decode(std::span<const U64> edges, DecoderListener& listener)
+{
+	const auto parts = split(edges);
+	mNumSegments = parts.size();
+	std::vector<SegmentRecorder> segments(mNumSegments);
+
+	std::atomic<size_t> nextSegment{0};
+	const auto work = [&]()
+	{
+		// whoever is done first takes the next one, so uneven segments even out
+		for (size_t i; (i = nextSegment.fetch_add(1, std::memory_order_relaxed)) < segments.size();)
+		{
+			auto& segment = segments[i];
+			const auto& part = parts[i];
+			segment.begin = part.begin < edges.size() ? edges[part.begin] : ~U64(0);
+			Decoder decoder(segment, mTickLength, mTolerance, mGlitch_ticks);
+			// only warms up the tick estimate
+			decoder.decode(edges.subspan(part.warmUp, part.begin - part.warmUp));
+			decoder.finish();
+			const U64 warmUpGlitches = decoder.getNumSuppressedGlitches();
+			decoder.decode(edges.subspan(part.begin, part.end - part.begin));
+			decoder.finish();
+			segment.numSuppressedGlitches = decoder.getNumSuppressedGlitches() - warmUpGlitches;
+		}
+	};
+
+	const size_t numThreads = std::min<size_t>(mNumThreads, segments.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < numThreads; i++)
+	{
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	mNumSuppressedGlitches = 0;
+	mLostSamples = 0;
+	for (const auto& segment : segments)
+	{
+		segment.replay(listener);
+		mNumSuppressedGlitches += segment.numSuppressedGlitches;
+		mLostSamples += segment.lostSamples;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "HKWireDecoder.h"
+
+#include <span>
+#include <vector>
+
+namespace HKWire
+{
+	// Decodes a whole capture on all cores.
+	//
+	// Every transmission ends with a long high, and after that the decoder has
+	// nothing left for the next one but its tick estimate. So the capture is split
+	// at highs longer than `split_ticks` and the segments are decoded independently,
+	// each with its own Decoder. To get to the same tick estimate, a decoder starts
+	// a few transmissions early and drops what it finds there.
+	// The results are handed to the listener segment after segment, which is
+	// sample order, from the calling thread.
+	//
+	// Only words, commands and lost stretches are passed on,
+	// markers and state advances stay with the segments.
+	class SegmentedDecoder
+	{
+	public:
+		// a transmission has no high longer than two ticks
+		static constexpr double defaultSplit_ticks = 10;
+		static constexpr double minSplit_ticks = Waveform::high + 1;
+		// gaps closer than this many edges are not split at, a decoder per transmission would cost more than it brings
+		static constexpr size_t minEdgesPerSegment = 1 << 12;
+		// decoded before a segment only for the tick estimate, some ten transmissions
+		static constexpr size_t warmUpEdges = 1 << 9;
+
+		// 0 threads uses every core
+		SegmentedDecoder(const TickLength& tickLength, const PulseTolerance& tolerance = {},
+		                 const double& glitch_ticks = 0, const double& split_ticks = defaultSplit_ticks,
+		                 const unsigned& numThreads = 0);
+
+		// Alternating edge timestamps of the whole capture, starting with a falling edge.
+		void
+		decode(std::span<const U64> edges, DecoderListener& listener);
+
+		U64
+		getNumSuppressedGlitches() const
+		{
+			return mNumSuppressedGlitches;
+		}
+
+		U64
+		getLostSamples() const
+		{
+			return mLostSamples;
+		}
+
+		size_t
+		getNumSegments() const
+		{
+			return mNumSegments;
+		}
+
+	private:
+		struct Segment
+		{
+			size_t warmUp;	// first edge to decode
+			size_t begin;	// first edge whose results count
+			size_t end;
+		};
+
+		std::vector<Segment>
+		split(std::span<const U64> edges) const;
+
+		const TickLength mTickLength;
+		const PulseTolerance mTolerance;
+		const double mGlitch_ticks;
+		const U64 mSplit_samples;
+		const unsigned mNumThreads;
+
+		U64 mNumSuppressedGlitches;
+		U64 mLostSamples;
+		size_t mNumSegments;
+	};
+}
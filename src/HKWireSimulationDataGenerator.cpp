@@ -0,0 +1,87 @@
+#include "HKWireSimulationDataGenerator.h"
+#include "HKWireAnalyzerSettings.h"
+
+#include <AnalyzerHelpers.h>
+
+#include <algorithm>
+#include <limits>
+
+HKWireSimulationDataGenerator::HKWireSimulationDataGenerator()
+:	mSettings( nullptr ),
+	mSimulationSampleRateHz( 0 ),
+	mDataSimulationData( nullptr ),
+	mBusySimulationData( nullptr ),
+	mBusyTransmission( 0 )
+{
+}
+
+HKWireSimulationDataGenerator::~HKWireSimulationDataGenerator()
+{
+}
+
+void HKWireSimulationDataGenerator::Initialize( U32 simulation_sample_rate, HKWireAnalyzerSettings* settings )
+{
+	mSimulationSampleRateHz = simulation_sample_rate;
+	mSettings = settings;
+
+	HKWire::TrafficConfig config;
+	config.sampleRate_Hz = simulation_sample_rate;
+	config.timeBase_us = mSettings->getNominalTimeBase_us();
+	// some sloppy timing, but no glitches: the simulation should decode cleanly
+	config.glitchProbability = 0;
+	mTraffic.reset( new HKWire::TrafficGenerator( config ) );
+
+	// the bus idles high, BUSY is released
+	mDataSimulationData = mSimulationChannels.Add( mSettings->mDataChannel, simulation_sample_rate, BIT_HIGH );
+	if (mSettings->hasBusyChannel())
+	{
+		mBusySimulationData = mSimulationChannels.Add( mSettings->mOptionalBusyChannel, simulation_sample_rate, BIT_HIGH );
+	}
+}
+
+U32 HKWireSimulationDataGenerator::GenerateSimulationData( U64 largest_sample_requested, U32 sample_rate, SimulationChannelDescriptor** simulation_channel )
+{
+	U64 adjusted_largest_sample_requested = AnalyzerHelpers::AdjustSimulationTargetSample( largest_sample_requested, sample_rate, mSimulationSampleRateHz );
+
+	while( mDataSimulationData->GetCurrentSampleNumber() < adjusted_largest_sample_requested )
+	{
+		AdvanceToNextEdge();
+		UpdateBusy();
+	}
+
+	*simulation_channel = mSimulationChannels.GetArray();
+	return mSimulationChannels.GetCount();
+}
+
+void HKWireSimulationDataGenerator::AdvanceToNextEdge()
+{
+	AdvanceTo( mDataSimulationData, mDataSimulationData->GetCurrentSampleNumber() + mTraffic->nextLevelDuration() );
+	mDataSimulationData->Transition();
+}
+
+void HKWireSimulationDataGenerator::UpdateBusy()
+{
+	if (mBusySimulationData == nullptr || mBusyTransmission == mTraffic->getNumTransmissions())
+	{
+		return;
+	}
+	mBusyTransmission = mTraffic->getNumTransmissions();
+
+	const U64 samplesPerTick = HKWire::getSamplesPerTick( mSettings->getNominalTimeBase_us(), mSimulationSampleRateHz );
+	const U64 start = mTraffic->getStartOfTransmission();
+	AdvanceTo( mBusySimulationData, std::max( mBusySimulationData->GetCurrentSampleNumber(), start - std::min( start, samplesPerTick ) ) );
+	mBusySimulationData->TransitionIfNeeded( BIT_LOW );
+	AdvanceTo( mBusySimulationData, mTraffic->getEndOfTransmission() );
+	mBusySimulationData->TransitionIfNeeded( BIT_HIGH );
+}
+
+void HKWireSimulationDataGenerator::AdvanceTo( SimulationChannelDescriptor* channel, U64 sample )
+{
+	U64 samples = sample - std::min( sample, channel->GetCurrentSampleNumber() );
+	while( samples > 0 )
+	{
+		const U32 step = U32( std::min< U64 >( samples, std::numeric_limits< U32 >::max() ) );
+		channel->Advance( step );
+		samples -= step;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef HKWire_SIMULATION_DATA_GENERATOR
+#define HKWire_SIMULATION_DATA_GENERATOR
+
+#include <SimulationChannelDescriptor.h>
+#include "HKWireTrafficGenerator.h"
+
+#include <memory>
+
+class HKWireAnalyzerSettings;
+
+class HKWireSimulationDataGenerator
+{
+public:
+	HKWireSimulationDataGenerator();
+	~HKWireSimulationDataGenerator();
+
+	void Initialize( U32 simulation_sample_rate, HKWireAnalyzerSettings* settings );
+	U32 GenerateSimulationData( U64 newest_sample_requested, U32 sample_rate, SimulationChannelDescriptor** simulation_channel );
+
+protected:
+	HKWireAnalyzerSettings* mSettings;
+	U32 mSimulationSampleRateHz;
+
+protected:
+	void AdvanceToNextEdge();
+	// held from a tick before the start bit until the end bit, already for the upcoming transmission
+	void UpdateBusy();
+	static void AdvanceTo( SimulationChannelDescriptor* channel, U64 sample );
+
+	std::unique_ptr< HKWire::TrafficGenerator > mTraffic;
+	SimulationChannelDescriptorGroup mSimulationChannels;
+	SimulationChannelDescriptor* mDataSimulationData;
+	SimulationChannelDescriptor* mBusySimulationData;	// nullptr without busy channel
+	U64 mBusyTransmission;	// the one BUSY was last driven for
+};
+#endif //HKWire_SIMULATION_DATA_GENERATOR
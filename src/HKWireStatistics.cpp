@@ -0,0 +1,136 @@
+#include "HKWireStatistics.h"
+
+#include <algorithm>
+#include <bit>
+
+using namespace HKWire;
+
+BusStatistics::BusStatistics(const U64& sampleRate_Hz)
+	: mSampleRate_Hz{std::max<U64>(sampleRate_Hz, 1)},
+	  mFlowIndex{},
+	  mFlows{},
+	  mNumCommands{0},
+	  mErrors{},
+	  mLostSamples{0}
+{
+	for (auto& byDest : mFlowIndex)
+	{
+		for (auto& byCommand : byDest)
+		{
+			byCommand.fill(noFlow);
+		}
+	}
+}
+
+size_t
+BusStatistics::getIntervalBucket(const U64& interval_samples) const
+{
+	const U64 interval_ms = interval_samples / mSampleRate_Hz * 1000 +
+	                        interval_samples % mSampleRate_Hz * 1000 / mSampleRate_Hz;
+	return std::min<size_t>(std::bit_width(interval_ms), numIntervalBuckets - 1);
+}
+
+void
+BusStatistics::addCommand(const CommandRecord& record)
+{
+	const auto& payload = record.payload;
+	auto& index = mFlowIndex[payload.source][payload.dest][payload.command];
+	if (index == noFlow)
+	{
+		index = FlowIndex(mFlows.size());
+		mFlows.push_back(Flow{payload.source, payload.dest, payload.command, 0, 0, record.start, record.start, {}});
+	}
+	auto& flow = mFlows[index];
+	if (flow.count > 0)
+	{
+		flow.intervals[getIntervalBucket(record.start - flow.lastSeen)]++;
+	}
+	flow.count++;
+	flow.withData += payload.data1.has_value() ? 1 : 0;
+	flow.lastSeen = record.start;
+	mNumCommands++;
+}
+
+void
+BusStatistics::addError(const DiagnosticKind& kind, const WordState& state)
+{
+	const auto row = kind == DiagnosticKind::lost ? WordState::_num : state;
+	mErrors[std::to_underlying(kind)][std::min<size_t>(std::to_underlying(row), numStates - 1)]++;
+}
+
+void
+BusStatistics::addLost(const U64& start, const U64& end)
+{
+	addError(DiagnosticKind::lost, WordState::_num);
+	mLostSamples += end - start;
+}
+
+void
+BusStatistics::write(ExportWriter& writer, const U64& trigger) const
+{
+	writer.text("Src,Dst,Cmd,Count,With data,First [s],Last [s],Interval <1 ms");
+	for (size_t i = 1; i + 1 < numIntervalBuckets; i++)
+	{
+		writer.text(",<");
+		writer.decimal(U64(1) << i);
+		writer.text(" ms");
+	}
+	writer.text(",>=");
+	writer.decimal(U64(1) << (numIntervalBuckets - 2));
+	writer.text(" ms\n");
+
+	forEachFlow([&](const Flow& flow)
+	{
+		writer.hex(flow.source, 4);
+		writer.put(',');
+		writer.hex(flow.dest, 4);
+		writer.put(',');
+		writer.hex(flow.command, 8);
+		writer.put(',');
+		writer.decimal(flow.count);
+		writer.put(',');
+		writer.decimal(flow.withData);
+		writer.put(',');
+		writer.time(flow.firstSeen, trigger, mSampleRate_Hz);
+		writer.put(',');
+		writer.time(flow.lastSeen, trigger, mSampleRate_Hz);
+		for (const auto& interval : flow.intervals)
+		{
+			writer.put(',');
+			writer.decimal(interval);
+		}
+		writer.put('\n');
+	});
+
+	writer.text("# commands,");
+	writer.decimal(mNumCommands);
+	writer.put('\n');
+	for (size_t kind = 0; kind < numDiagnosticKinds; kind++)
+	{
+		for (size_t state = 0; state < numStates; state++)
+		{
+			const U64 count = mErrors[kind][state];
+			if (count == 0)
+			{
+				continue;
+			}
+			writer.text("# ");
+			writer.text(getNameOfDiagnosticKind(DiagnosticKind(kind)));
+			if (DiagnosticKind(kind) != DiagnosticKind::lost)
+			{
+				writer.text(" in ");
+				writer.text(getNameOfWordState(WordState(state)));
+			}
+			writer.put(',');
+			writer.decimal(count);
+			writer.put('\n');
+		}
+	}
+	if (mLostSamples > 0)
+	{
+		// as a time, not relative to anything
+		writer.text("# lost [s],");
+		writer.time(mLostSamples, 0, mSampleRate_Hz);
+		writer.put('\n');
+	}
+}
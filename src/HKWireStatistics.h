@@ -0,0 +1,109 @@
+#pragma once
+
+#include "HKWire.h"
+#include "HKWireDiagnostics.h"
+#include "HKWireExport.h"
+#include "HKWireRecord.h"
+
+#include <array>
+#include <vector>
+
+namespace HKWire
+{
+	// Who talks to whom how often, collected while decoding.
+	// Every (source, dest, command) seen gets a flow with its count, first and
+	// last start and a histogram of the time between two of them. The flows are
+	// found through a fixed table indexed by the IDs and the command, so a command
+	// costs a lookup and a few additions, whatever the length of the capture.
+	class BusStatistics
+	{
+	public:
+		// [0, 1) ms, then [2^(i-1), 2^i) ms, the last one open ended
+		static constexpr size_t numIntervalBuckets = 16;
+
+		struct Flow
+		{
+			ID source;
+			ID dest;
+			Command command;
+			U64 count;
+			U64 withData;
+			U64 firstSeen;	// start of the first one
+			U64 lastSeen;
+			std::array<U32, numIntervalBuckets> intervals;	// from one start to the next
+		};
+
+		explicit BusStatistics(const U64& sampleRate_Hz);
+
+		void
+		addCommand(const CommandRecord& record);
+
+		// `state` is ignored for DiagnosticKind::lost
+		void
+		addError(const DiagnosticKind& kind, const WordState& state);
+
+		void
+		addLost(const U64& start, const U64& end);
+
+		// ordered by source, dest and command
+		template<typename Sink>
+		void
+		forEachFlow(Sink&& sink) const
+		{
+			for (const auto& byDest : mFlowIndex)
+			{
+				for (const auto& byCommand : byDest)
+				{
+					for (const auto& index : byCommand)
+					{
+						if (index != noFlow)
+						{
+							sink(mFlows[index]);
+						}
+					}
+				}
+			}
+		}
+
+		U64
+		getNumCommands() const
+		{
+			return mNumCommands;
+		}
+
+		U64
+		getNumErrors(const DiagnosticKind& kind, const WordState& state) const
+		{
+			return mErrors[std::to_underlying(kind)][std::to_underlying(state)];
+		}
+
+		U64
+		getLostSamples() const
+		{
+			return mLostSamples;
+		}
+
+		// interval bucket from one start to the next
+		size_t
+		getIntervalBucket(const U64& interval_samples) const;
+
+		// Summary as csv, one flow per line, the errors as comments at the end.
+		// Times are relative to `trigger`.
+		void
+		write(ExportWriter& writer, const U64& trigger) const;
+
+	private:
+		using FlowIndex = U32;
+		static constexpr FlowIndex noFlow = ~FlowIndex(0);
+		static constexpr size_t numDiagnosticKinds = std::to_underlying(DiagnosticKind::lost) + 1;
+		static constexpr size_t numStates = std::to_underlying(WordState::_num) + 1;
+
+		const U64 mSampleRate_Hz;
+		// 256 KiB, a Flow for every possible combination would be 6 MiB
+		std::array<std::array<std::array<FlowIndex, numCommands>, numIDs>, numIDs> mFlowIndex;
+		std::vector<Flow> mFlows;
+		U64 mNumCommands;
+		std::array<std::array<U64, numStates>, numDiagnosticKinds> mErrors;
+		U64 mLostSamples;
+	};
+}
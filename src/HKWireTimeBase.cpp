@@ -0,0 +1,98 @@
+#include "HKWireTimeBase.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace HKWire;
+
+namespace
+{
+	// sorted neighbours further apart than this belong to different lengths
+	constexpr U64 clusterGapPercent = 125;
+	// same as the default PulseTolerance
+	constexpr double matchTolerance_ticks = 0.5;
+	// below that it is not our protocol, or the noise makes it a guess
+	constexpr size_t minMatchingPercent = 75;
+	// the first guess comes from a single cluster, after that all pulses count
+	constexpr unsigned refinements = 3;
+
+	constexpr BitType lowPulseBits[] = {BitType::data0, BitType::data1, BitType::start};
+
+	struct Fit
+	{
+		double samplesPerTick;
+		size_t matching;
+	};
+
+	// Least squares over every pulse that is close to a known length:
+	// the jitter is in samples, not relative, so long pulses are worth more.
+	Fit
+	fitSamplesPerTick(std::span<const U64> lowPulses_samples, const double& estimate)
+	{
+		double samplesTimesTicks = 0;
+		double ticksSquared = 0;
+		size_t matching = 0;
+		for (const auto& pulse : lowPulses_samples)
+		{
+			for (const auto bit : lowPulseBits)
+			{
+				const double low = getWaveformForBit(bit)->low;
+				const double deviation = pulse / estimate - low;
+				if (deviation >= -matchTolerance_ticks && deviation <= matchTolerance_ticks)
+				{
+					samplesTimesTicks += pulse * low;
+					ticksSquared += low * low;
+					matching++;
+					break;
+				}
+			}
+		}
+		return Fit{matching > 0 ? samplesTimesTicks / ticksSquared : estimate, matching};
+	}
+}
+
+std::optional<TickLength>
+TimeBase::detectTickLength(std::span<const U64> lowPulses_samples)
+{
+	if (lowPulses_samples.size() < minDetectionPulses)
+	{
+		return std::nullopt;
+	}
+	std::vector<U64> sorted(lowPulses_samples.begin(), lowPulses_samples.end());
+	std::sort(sorted.begin(), sorted.end());
+
+	// Every cluster that is not just a few glitches could be any of the lengths.
+	// The right guess is the one that explains the most pulses.
+	const size_t minClusterSize = std::max<size_t>(2, sorted.size() / 32);
+	std::optional<Fit> best;
+	size_t begin = 0;
+	for (size_t i = 1; i <= sorted.size(); i++)
+	{
+		if (i < sorted.size() && sorted[i] * 100 <= sorted[i - 1] * clusterGapPercent)
+		{
+			continue;
+		}
+		const U64 median = sorted[(begin + i) / 2];
+		if (i - begin >= minClusterSize && median >= getWaveformForBit(BitType::start)->low)
+		{
+			for (const auto bit : lowPulseBits)
+			{
+				Fit fit{double(median) / getWaveformForBit(bit)->low, 0};
+				for (unsigned r = 0; r < refinements; r++)
+				{
+					fit = fitSamplesPerTick(lowPulses_samples, fit.samplesPerTick);
+				}
+				if (!best.has_value() || fit.matching > best->matching)
+				{
+					best = fit;
+				}
+			}
+		}
+		begin = i;
+	}
+	if (!best.has_value() || best->matching * 100 < lowPulses_samples.size() * minMatchingPercent)
+	{
+		return std::nullopt;
+	}
+	return TickLength{U64(best->samplesPerTick * TickLength::one + 0.5)};
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "HKWire.h"
+
+namespace HKWire
+{
+	// Finding the tick length from the recording instead of the settings.
+	//
+	// The low pulses of a transmission come in three lengths only (2, 7, 11 ticks).
+	// The sorted pulses are cut into clusters of similar lengths, and every cluster
+	// that is more than a few glitches is tried as each of the three. A guess is
+	// refined by a least squares fit over all pulses close to a known length, and
+	// the one that fits the most pulses wins, if that is most of them.
+	namespace TimeBase
+	{
+		// enough for a few transmissions
+		static constexpr size_t detectionPulses = 128;
+		// about one transmission without data, if the bus goes quiet afterwards
+		static constexpr size_t minDetectionPulses = 16;
+
+		std::optional<TickLength>
+		detectTickLength(std::span<const U64> lowPulses_samples);
+	}
+}
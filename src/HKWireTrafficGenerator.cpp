@@ -0,0 +1,144 @@
+#include "HKWireTrafficGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace HKWire;
+
+TrafficGenerator::TrafficGenerator(const TrafficConfig& config)
+	: mConfig{config},
+	  mSamplesPerTick{double(config.sampleRate_Hz) * config.timeBase_us / (1000 * 1000)},
+	  mRandom{config.seed},
+	  mPayload{},
+	  mNumTransmissions{0},
+	  mLevels{},
+	  mNextLevel{0},
+	  mPreviousTransmissionLength{0},
+	  mClock{1 + config.clockOffset},
+	  mStartOfTransmission{0},
+	  mEndOfTransmission{0},
+	  mPosition{0}
+{
+}
+
+U64
+TrafficGenerator::nextLevelDuration()
+{
+	if (mNextLevel >= mLevels.size())
+	{
+		encodeNextTransmission();
+	}
+	mPosition += mLevels[mNextLevel];
+	return mLevels[mNextLevel++];
+}
+
+U64
+TrafficGenerator::nextEdge()
+{
+	nextLevelDuration();
+	return mPosition;
+}
+
+Payload
+TrafficGenerator::randomPayload()
+{
+	std::uniform_real_distribution<double> chance(0, 1);
+	std::uniform_int_distribution<unsigned> byte(0, 0xFF);
+
+	// pick a known command, so the traffic looks a bit like the real bus
+	std::uniform_int_distribution<size_t> pickCommand(0, knownCommands.size() - 1);
+	const auto& command = knownCommands[pickCommand(mRandom)];
+	std::uniform_int_distribution<size_t> pickSource(0, knownIDs.size() - 1);
+	const auto& source = knownIDs[pickSource(mRandom)];
+
+	Payload payload(source.id, command.dest, command.command);
+	const auto data = chance(mRandom);
+	if (data < mConfig.data16Ratio)
+	{
+		payload.data1 = byte(mRandom);
+		payload.data2 = byte(mRandom);
+	}
+	else if (data < mConfig.data16Ratio + mConfig.data8Ratio)
+	{
+		payload.data1 = byte(mRandom);
+	}
+	return payload;
+}
+
+void
+TrafficGenerator::addLevel(double samples)
+{
+	std::uniform_real_distribution<double> chance(0, 1);
+	const double glitch = std::max(1.0, mConfig.glitchWidth * mSamplesPerTick);
+	if (chance(mRandom) < mConfig.glitchProbability && samples > glitch + 2)
+	{
+		// a short pulse of the other level somewhere in between
+		std::uniform_real_distribution<double> where(1, samples - glitch - 1);
+		const double before = where(mRandom);
+		mLevels.push_back(std::llround(before));
+		mLevels.push_back(std::llround(glitch));
+		samples -= before + glitch;
+	}
+	mLevels.push_back(std::max<U64>(1, std::llround(samples)));
+}
+
+void
+TrafficGenerator::encodeNextTransmission()
+{
+	mLevels.clear();
+	mNextLevel = 0;
+	mPayload = randomPayload();
+	mNumTransmissions++;
+
+	if (mConfig.clockDrift > 0)
+	{
+		// only then, to keep the traffic of a seed the same without drift
+		std::uniform_real_distribution<double> drift(-mConfig.clockDrift, mConfig.clockDrift);
+		mClock = std::clamp(mClock + drift(mRandom), 1 - mConfig.maxClockDeviation, 1 + mConfig.maxClockDeviation);
+	}
+	std::uniform_real_distribution<double> jitter(-mConfig.tickJitter, mConfig.tickJitter);
+	const auto ticksToSamples = [&](Ticks ticks)
+	{
+		return (ticks + jitter(mRandom)) * mSamplesPerTick * mClock;
+	};
+
+	std::vector<Ticks> lowTicks;
+	forEachBit(mPayload, [&](const BitType& bit)
+	{
+		lowTicks.push_back(getWaveformForBit(bit)->low);
+	});
+
+	// idle time before this transmission, which is also the high phase of the previous end bit.
+	// Transmissions start at the configured rate, unless they would not fit.
+	const double period = mConfig.commandsPerSecond > 0
+	                      ? mConfig.sampleRate_Hz / mConfig.commandsPerSecond
+	                      : 0;
+	addLevel(std::max(mConfig.minimumIdleTicks * mSamplesPerTick,
+	                  period - mPreviousTransmissionLength));
+	mStartOfTransmission = mPosition;
+	for (const auto& level : mLevels)
+	{
+		mStartOfTransmission += level;
+	}
+	const size_t idleLevels = mLevels.size();
+
+	double length = 0;
+	for (size_t i = 0; i < lowTicks.size(); i++)
+	{
+		const auto low = ticksToSamples(lowTicks[i]);
+		addLevel(low);
+		length += low;
+		if (i + 1 < lowTicks.size())
+		{
+			const auto high = ticksToSamples(Waveform::high);
+			addLevel(high);
+			length += high;
+		}
+	}
+	mPreviousTransmissionLength = length;
+	mEndOfTransmission = mStartOfTransmission;
+	for (size_t i = idleLevels; i < mLevels.size(); i++)
+	{
+		mEndOfTransmission += mLevels[i];
+	}
+}
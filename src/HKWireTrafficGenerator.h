@@ -0,0 +1,125 @@
+#pragma once
+
+#include "HKWire.h"
+
+#include <random>
+#include <vector>
+
+namespace HKWire
+{
+	// Calls `sink(BitType)` for every bit of one transmission, in wire order.
+	template<typename Sink>
+	constexpr void
+	forEachBit(const Payload& payload, Sink&& sink)
+	{
+		sink(BitType::start);
+		for (auto word = WordState::source; word != WordState::end;
+		     word = static_cast<WordState>(std::to_underlying(word) + 1))
+		{
+			if ((word == WordState::data1 && !payload.data1.has_value()) ||
+			    (word == WordState::data2 && !payload.data2.has_value()))
+			{
+				continue;
+			}
+			const auto value = payload.getWord(word);
+			const auto bits = *getBitsPerWord(word);
+			for (Bits i = 0; i < bits; i++)
+			{
+				const bool bit = (value >> (bits - 1 - i)) & 1;	// MSB first
+				sink(bit ? BitType::data1 : BitType::data0);
+			}
+		}
+		sink(BitType::end);
+	}
+
+	struct TrafficConfig
+	{
+		U64 sampleRate_Hz = 24000000;
+		U64 timeBase_us = 560;
+		double commandsPerSecond = 10;
+		// every low and high phase is off by up to this fraction of a tick
+		double tickJitter = 0.1;
+		// the clock of the sending unit is off by this fraction (0.02 = 2% longer ticks)
+		double clockOffset = 0;
+		// ... and changes by up to this fraction from one transmission to the next,
+		// never more than maxClockDeviation away from nominal
+		double clockDrift = 0;
+		double maxClockDeviation = 0.1;
+		// share of commands carrying one or two data bytes
+		double data8Ratio = 0.2;
+		double data16Ratio = 0.2;
+		// chance for every low and high phase to contain a glitch
+		double glitchProbability = 0;
+		// width of a glitch, as fraction of a tick
+		double glitchWidth = 0.05;
+		// idle time of the line after the end bit, if the command rate allows none
+		Ticks minimumIdleTicks = 14;	// about 8ms
+		U64 seed = 0x48; // 'H'
+	};
+
+	// Endless, reproducible bus traffic as alternating line levels.
+	// The line idles high, so the first level is high.
+	class TrafficGenerator
+	{
+	public:
+		explicit TrafficGenerator(const TrafficConfig& config);
+
+		// Samples until the next edge. Levels alternate, starting high.
+		U64
+		nextLevelDuration();
+
+		// Absolute sample of the next edge.
+		U64
+		nextEdge();
+
+		// the payload of the transmission currently on the line
+		const Payload&
+		getCurrentPayload() const
+		{
+			return mPayload;
+		}
+
+		// sample of the falling edge of its start bit
+		U64
+		getStartOfTransmission() const
+		{
+			return mStartOfTransmission;
+		}
+
+		// sample of the rising edge of its end bit
+		U64
+		getEndOfTransmission() const
+		{
+			return mEndOfTransmission;
+		}
+
+		U64
+		getNumTransmissions() const
+		{
+			return mNumTransmissions;
+		}
+
+	private:
+		void
+		encodeNextTransmission();
+		Payload
+		randomPayload();
+		// adds a level, maybe split by a glitch
+		void
+		addLevel(double samples);
+
+		const TrafficConfig mConfig;
+		const double mSamplesPerTick;
+		std::mt19937_64 mRandom;
+
+		Payload mPayload;
+		U64 mNumTransmissions;
+		std::vector<U64> mLevels;	// durations, alternating starting high
+		size_t mNextLevel;
+		double mPreviousTransmissionLength;	// samples from start to end bit
+		double mClock;	// tick length of the sender, relative to nominal
+		U64 mStartOfTransmission;
+		U64 mEndOfTransmission;
+		U64 mPosition;	// sample of the last edge handed out
+	};
+}
@@ -0,0 +1,87 @@
+#include "HKWireTransactions.h"
+
+using namespace HKWire;
+
+namespace
+{
+    constexpr TransactionRule rules[] =
+    {
+        // Tape deck reports a playable tape, tuner acknowledges
+        {0x3, 0x0, 0x07, 0x1C},
+        // FF/FR speed changes are answered with the new speed
+        {0x0, 0x3, 0x08, 0x0B},
+        {0x0, 0x3, 0x09, 0x0B},
+    };
+}
+
+const std::span<const TransactionRule> HKWire::knownTransactions = rules;
+
+TransactionMatcher::TransactionMatcher(const U64& maxResponseDelay)
+	: mMaxResponseDelay{maxResponseDelay},
+	  mPending{},
+	  mNumUnanswered{0}
+{
+}
+
+void
+TransactionMatcher::Queue::erase(const size_t& index)
+{
+	for (size_t i = index; i + 1 < size; i++)
+	{
+		entries[i] = entries[i + 1];
+	}
+	size--;
+}
+
+void
+TransactionMatcher::expire(Queue& queue, const U64& now)
+{
+	while (mMaxResponseDelay != 0 && queue.size > 0 &&
+	       now - queue.entries[0].start > mMaxResponseDelay)
+	{
+		queue.erase(0);
+		mNumUnanswered++;
+	}
+}
+
+std::optional<TransactionMatcher::Match>
+TransactionMatcher::onCommand(const CommandRecord& record, const U64& tag)
+{
+	const auto& payload = record.payload;
+	const ID src = payload.source;
+	const ID dst = payload.dest;
+
+	// is this the answer to something we sent the other way?
+	std::optional<Match> match;
+	auto& answered = mPending[dst][src];
+	expire(answered, record.start);
+	for (size_t i = 0; i < answered.size; i++)
+	{
+		const auto& pending = answered.entries[i];
+		if (pending.response == payload.command)
+		{
+			match = Match{pending.tag, pending.start, pending.request};
+			answered.erase(i);
+			break;
+		}
+	}
+
+	// does it want an answer itself?
+	for (const auto& rule : knownTransactions)
+	{
+		if (rule.requestSource != src || rule.requestDest != dst || rule.request != payload.command)
+		{
+			continue;
+		}
+		auto& queue = mPending[src][dst];
+		expire(queue, record.start);
+		if (queue.size == queue.entries.size())
+		{
+			queue.erase(0);
+			mNumUnanswered++;
+		}
+		queue.entries[queue.size++] = Pending{tag, record.start, rule.request, rule.response};
+		break;
+	}
+	return match;
+}
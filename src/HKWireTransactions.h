@@ -0,0 +1,74 @@
+#pragma once
+
+#include "HKWire.h"
+#include "HKWireRecord.h"
+
+namespace HKWire
+{
+	// A command that is answered by another one, sent back the opposite way.
+	struct TransactionRule
+	{
+		ID requestSource;
+		ID requestDest;
+		Command request;
+		Command response;	// from requestDest to requestSource
+	};
+
+	extern const std::span<const TransactionRule> knownTransactions;
+
+	// Pairs requests with their answers in a single pass over the commands.
+	// Open requests wait in a small fixed queue per (source, dest), the oldest
+	// one is dropped if too many pile up or their answer takes too long.
+	class TransactionMatcher
+	{
+	public:
+		static constexpr size_t maxPendingPerPair = 4;
+
+		struct Match
+		{
+			U64 requestTag;
+			U64 requestStart;
+			Command request;
+		};
+
+		// `maxResponseDelay` in samples from start to start, 0 waits forever
+		explicit TransactionMatcher(const U64& maxResponseDelay);
+
+		// `tag` identifies the command for the caller (packet id, index, ...).
+		// Returns the request this command answers, if any.
+		std::optional<Match>
+		onCommand(const CommandRecord& record, const U64& tag);
+
+		// requests that never got an answer (so far)
+		U64
+		getNumUnanswered() const
+		{
+			return mNumUnanswered;
+		}
+
+	private:
+		struct Pending
+		{
+			U64 tag;
+			U64 start;
+			Command request;
+			Command response;
+		};
+
+		struct Queue
+		{
+			std::array<Pending, maxPendingPerPair> entries;
+			U8 size = 0;	// oldest first
+
+			void
+			erase(const size_t& index);
+		};
+
+		void
+		expire(Queue& queue, const U64& now);
+
+		const U64 mMaxResponseDelay;
+		std::array<std::array<Queue, numIDs>, numIDs> mPending;	// [source][dest] of the request
+		U64 mNumUnanswered;
+	};
+}
@@ -0,0 +1,438 @@
+// Regression test against the real recordings in doc/captures:
+// every capture is decoded like `hkwire-decode capture.sal` does and compared
+// with the expected commands in test/captures/<capture>.csv.
+// Decode time and peak memory are recorded per capture and, given a baseline,
+// checked like hkwire-bench does. The exit code is 1 on any difference or regression.
+//
+// After an intended change of the decoding, `--write-expected` stores the new
+// output (which is also what hkwire-decode prints, so the diff shows what changed).
+
+#include "HKWireDecoder.h"
+#include "HKWireSalReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace HKWire;
+
+// -------- PEAK MEMORY
+
+namespace
+{
+	// every block carries its size, so the current amount in use is known
+	constexpr size_t sizeHeader = alignof(std::max_align_t);
+	bool gTrackMemory = false;
+	U64 gBytesInUse = 0;
+	U64 gPeakBytes = 0;
+}
+
+void*
+operator new(std::size_t size)
+{
+	auto* block = static_cast<char*>(std::malloc(size + sizeHeader));
+	if (block == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	*reinterpret_cast<std::size_t*>(block) = size;
+	if (gTrackMemory)
+	{
+		gBytesInUse += size;
+		gPeakBytes = std::max(gPeakBytes, gBytesInUse);
+	}
+	return block + sizeHeader;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+	if (ptr == nullptr)
+	{
+		return;
+	}
+	auto* block = static_cast<char*>(ptr) - sizeHeader;
+	if (gTrackMemory)
+	{
+		// blocks from before tracking started are not counted either way
+		gBytesInUse -= std::min<U64>(gBytesInUse, *reinterpret_cast<std::size_t*>(block));
+	}
+	std::free(block);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+namespace
+{
+	struct Options
+	{
+		std::filesystem::path captures;
+		std::filesystem::path expected;
+		unsigned repeat = 20;
+		double tolerance = 0.5;
+		const char* baseline = nullptr;
+		const char* writeBaseline = nullptr;
+		bool writeExpected = false;
+	};
+
+	struct Result
+	{
+		double edgesPerSecond = 0;	// decoding only, the best run
+		double readSeconds = 0;		// inflating the capture
+		double peakBytes = 0;		// reading and decoding
+	};
+
+	// the csv of hkwire-decode
+	class CsvListener : public DecoderListener
+	{
+	public:
+		explicit CsvListener(const U64& sampleRate_Hz)
+			: mSampleRate_Hz{double(sampleRate_Hz)}
+		{
+			text = "Time [s],Type,Src,Dst,Cmd,Dat\n";
+		}
+
+		void
+		onMarker(const U64&, const Marker&, const HKWireState&) override
+		{
+		}
+
+		void
+		onCommand(const CommandRecord& record) override
+		{
+			const auto& payload = record.payload;
+			const bool withData = payload.data1.has_value();
+			char line[128];
+			int length = std::snprintf(line, sizeof(line), "%.15f,%s,0x%X,0x%X,0x%02X",
+			                           record.start / mSampleRate_Hz,
+			                           withData ? "command with data" : "command",
+			                           unsigned(payload.source), unsigned(payload.dest), unsigned(payload.command));
+			if (withData)
+			{
+				length += std::snprintf(line + length, sizeof(line) - length,
+				                        payload.data2.has_value() ? ",0x%04X" : ",0x%02X",
+				                        unsigned(payload.getDataInHostOrder()));
+			}
+			text.append(line, size_t(length));
+			text += '\n';
+		}
+
+		std::string text;
+
+	private:
+		const double mSampleRate_Hz;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	// the whole capture, the same way hkwire-decode reads it
+	std::optional<std::vector<U64>>
+	readCapture(const std::filesystem::path& path, U64& sampleRate_Hz)
+	{
+		SalReader reader(path.string().c_str(), 0);
+		if (!reader.isOpen())
+		{
+			std::printf("%s: %s\n", path.filename().string().c_str(), reader.getError().c_str());
+			return std::nullopt;
+		}
+		sampleRate_Hz = reader.getSampleRate_Hz();
+		std::vector<U64> edges;
+		std::vector<U64> block;
+		bool skipEdge = reader.isInitialLow();
+		while (reader.read(block))
+		{
+			const auto first = block.begin() + (skipEdge ? 1 : 0);
+			skipEdge = false;
+			edges.insert(edges.end(), first, block.end());
+		}
+		if (!reader.isOpen())
+		{
+			std::printf("%s: %s\n", path.filename().string().c_str(), reader.getError().c_str());
+			return std::nullopt;
+		}
+		return edges;
+	}
+
+	std::string
+	decode(const std::vector<U64>& edges, const U64& sampleRate_Hz)
+	{
+		CsvListener listener(sampleRate_Hz);
+		Decoder decoder(listener, TickLength::fromTimeBase(560, sampleRate_Hz), PulseTolerance{},
+		                GlitchFilter::defaultWidth_ticks);
+		decoder.decode(edges);
+		decoder.finish();
+		return std::move(listener.text);
+	}
+
+	std::string
+	readFile(const std::filesystem::path& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::stringstream content;
+		content << in.rdbuf();
+		return content.str();
+	}
+
+	// first line that differs, for the log
+	void
+	printDifference(const std::string& name, const std::string& expected, const std::string& actual)
+	{
+		std::istringstream expectedLines(expected);
+		std::istringstream actualLines(actual);
+		std::string expectedLine;
+		std::string actualLine;
+		for (size_t line = 1; ; line++)
+		{
+			const bool hasExpected = bool(std::getline(expectedLines, expectedLine));
+			const bool hasActual = bool(std::getline(actualLines, actualLine));
+			if (!hasExpected && !hasActual)
+			{
+				return;
+			}
+			if (!hasExpected || !hasActual || expectedLine != actualLine)
+			{
+				std::printf("%s, line %zu:\n  expected: %s\n  decoded:  %s\n", name.c_str(), line,
+				            hasExpected ? expectedLine.c_str() : "(end)", hasActual ? actualLine.c_str() : "(end)");
+				return;
+			}
+		}
+	}
+
+	std::map<std::string, Result>
+	readBaseline(const char* path)
+	{
+		std::map<std::string, Result> baseline;
+		std::ifstream in(path);
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			// names have spaces, but no commas
+			const auto comma = line.find(',');
+			Result result;
+			if (comma != std::string::npos &&
+			    std::sscanf(line.c_str() + comma + 1, "%lf,%lf,%lf",
+			                &result.edgesPerSecond, &result.readSeconds, &result.peakBytes) == 3)
+			{
+				baseline[line.substr(0, comma)] = result;
+			}
+		}
+		return baseline;
+	}
+
+	void
+	printUsage(const char* name)
+	{
+		std::fprintf(stderr,
+			"usage: %s --captures DIR --expected DIR [options]\n"
+			"      --captures DIR       the .sal files to decode\n"
+			"      --expected DIR       <capture>.csv with the expected commands\n"
+			"      --write-expected     store the decoded commands as expected instead\n"
+			"      --repeat N           decodes per capture, the best counts (default 20)\n"
+			"      --baseline FILE      fail if slower or bigger than FILE allows\n"
+			"      --tolerance RATIO    allowed slowdown against the baseline (default 0.5)\n"
+			"      --write-baseline FILE  store the results as new baseline\n",
+			name);
+	}
+
+	std::optional<Options>
+	parseArguments(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (arg == "--captures" && hasValue)
+			{
+				options.captures = argv[++i];
+			}
+			else if (arg == "--expected" && hasValue)
+			{
+				options.expected = argv[++i];
+			}
+			else if (arg == "--write-expected")
+			{
+				options.writeExpected = true;
+			}
+			else if (arg == "--repeat" && hasValue)
+			{
+				options.repeat = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (arg == "--baseline" && hasValue)
+			{
+				options.baseline = argv[++i];
+			}
+			else if (arg == "--tolerance" && hasValue)
+			{
+				options.tolerance = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--write-baseline" && hasValue)
+			{
+				options.writeBaseline = argv[++i];
+			}
+			else
+			{
+				return std::nullopt;
+			}
+		}
+		if (options.captures.empty() || options.expected.empty())
+		{
+			return std::nullopt;
+		}
+		return options;
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	const auto maybeOptions = parseArguments(argc, argv);
+	if (!maybeOptions.has_value())
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+	const auto& options = *maybeOptions;
+
+	std::vector<std::filesystem::path> captures;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(options.captures, error))
+	{
+		if (entry.path().extension() == ".sal")
+		{
+			captures.push_back(entry.path());
+		}
+	}
+	if (captures.empty())
+	{
+		std::fprintf(stderr, "no captures in %s\n", options.captures.string().c_str());
+		return 2;
+	}
+	std::sort(captures.begin(), captures.end());
+
+	std::map<std::string, Result> baseline;
+	if (options.baseline != nullptr)
+	{
+		baseline = readBaseline(options.baseline);
+		if (baseline.empty())
+		{
+			std::fprintf(stderr, "no usable baseline in %s\n", options.baseline);
+			return 2;
+		}
+	}
+	std::FILE* write = nullptr;
+	if (options.writeBaseline != nullptr)
+	{
+		write = std::fopen(options.writeBaseline, "w");
+		if (write == nullptr)
+		{
+			std::perror(options.writeBaseline);
+			return 2;
+		}
+		std::fputs("# capture,edges/s,read s,peak bytes\n", write);
+	}
+
+	std::printf("%-52s %8s %8s %10s %10s %10s\n", "capture", "edges", "frames", "Medges/s", "read ms", "peak KiB");
+	bool failed = false;
+	for (const auto& path : captures)
+	{
+		const std::string name = path.stem().string();
+		Result result;
+
+		gBytesInUse = 0;
+		gPeakBytes = 0;
+		gTrackMemory = true;
+		const auto readBegin = Clock::now();
+		U64 sampleRate_Hz = 0;
+		const auto edges = readCapture(path, sampleRate_Hz);
+		const std::chrono::duration<double> readTime = Clock::now() - readBegin;
+		if (!edges.has_value())
+		{
+			gTrackMemory = false;
+			failed = true;
+			continue;
+		}
+		result.readSeconds = readTime.count();
+
+		std::string decoded;
+		double bestDecode = 1e300;
+		for (unsigned i = 0; i < options.repeat; i++)
+		{
+			const auto begin = Clock::now();
+			decoded = decode(*edges, sampleRate_Hz);
+			const std::chrono::duration<double> decodeTime = Clock::now() - begin;
+			bestDecode = std::min(bestDecode, decodeTime.count());
+		}
+		gTrackMemory = false;
+		result.edgesPerSecond = edges->size() / bestDecode;
+		result.peakBytes = double(gPeakBytes);
+		const size_t numFrames = size_t(std::count(decoded.begin(), decoded.end(), '\n')) - 1;
+
+		std::printf("%-52s %8zu %8zu %10.2f %10.3f %10.1f", name.c_str(), edges->size(), numFrames,
+		            result.edgesPerSecond / 1e6, result.readSeconds * 1e3, result.peakBytes / 1024);
+		if (write != nullptr)
+		{
+			std::fprintf(write, "%s,%.0f,%.6f,%.0f\n", name.c_str(),
+			             result.edgesPerSecond, result.readSeconds, result.peakBytes);
+		}
+
+		const auto base = baseline.find(name);
+		if (base != baseline.end())
+		{
+			const auto& expected = base->second;
+			const bool slower = result.edgesPerSecond < expected.edgesPerSecond * (1 - options.tolerance);
+			// the edges themselves are most of it, a little slack for the allocator
+			const bool fatter = result.peakBytes > expected.peakBytes * (1 + options.tolerance) + 4096;
+			if (slower || fatter)
+			{
+				std::printf("  REGRESSION (baseline %.2f Medges/s, %.1f KiB)",
+				            expected.edgesPerSecond / 1e6, expected.peakBytes / 1024);
+				failed = true;
+			}
+		}
+		std::printf("\n");
+
+		const auto expectedPath = options.expected / (name + ".csv");
+		if (options.writeExpected)
+		{
+			std::ofstream out(expectedPath, std::ios::binary);
+			out << decoded;
+			failed |= !out.good();
+			continue;
+		}
+		const std::string expected = readFile(expectedPath);
+		if (expected.empty())
+		{
+			std::printf("%s: nothing expected, see --write-expected\n", expectedPath.string().c_str());
+			failed = true;
+		}
+		else if (expected != decoded)
+		{
+			printDifference(name, expected, decoded);
+			failed = true;
+		}
+	}
+
+	if (write != nullptr && std::fclose(write) != 0)
+	{
+		failed = true;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+// Test of the edge search in raw recordings (src/HKWireRawSamples.h):
+// every kernel is checked against a bit by bit reference, on random words with
+// dense and sparse edges, edges right at word borders, captures cut into chunks
+// of whole words and a partial last word. The exit code is 1 on any difference.
+
+#include "HKWireRawSamples.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HKWire;
+
+namespace
+{
+	constexpr unsigned samplesPerWord = 64;
+
+	bool
+	getSample(const std::vector<U64>& words, const U64& sample)
+	{
+		return (words[sample / samplesPerWord] >> (sample % samplesPerWord)) & 1;
+	}
+
+	// the first sample only sets the level, like EdgeExtractor::extract()
+	std::vector<U64>
+	findEdgesBitByBit(const std::vector<U64>& words, const U64& numSamples)
+	{
+		std::vector<U64> edges;
+		for (U64 sample = 1; sample < numSamples; sample++)
+		{
+			if (getSample(words, sample) != getSample(words, sample - 1))
+			{
+				edges.push_back(sample);
+			}
+		}
+		return edges;
+	}
+
+	enum class Pattern
+	{
+		random,			// an edge every other sample
+		sparse,			// long quiet stretches, what the vector kernels skip
+		wordBorders,	// edges only between bit 63 of a word and bit 0 of the next
+		quiet,			// no edge at all
+	};
+
+	std::vector<U64>
+	makeWords(const Pattern& pattern, const size_t& numWords, std::mt19937_64& random)
+	{
+		std::vector<U64> words(numWords);
+		bool level = random() & 1;
+		for (auto& word : words)
+		{
+			switch (pattern)
+			{
+				case Pattern::random:
+					word = random();
+					break;
+				case Pattern::sparse:
+					word = level ? ~U64(0) : 0;
+					if (random() % 16 == 0)
+					{
+						// a short pulse somewhere in it, or a level change at a random bit
+						const unsigned bit = random() % samplesPerWord;
+						word ^= random() % 2 == 0 ? U64(1) << bit : ~U64(0) << bit;
+						level = word >> (samplesPerWord - 1);
+					}
+					break;
+				case Pattern::wordBorders:
+					if (random() % 3 == 0)
+					{
+						level = !level;
+					}
+					word = level ? ~U64(0) : 0;
+					break;
+				case Pattern::quiet:
+					word = level ? ~U64(0) : 0;
+					break;
+			}
+		}
+		return words;
+	}
+
+	// in chunks of whole words, the last one may end inside a word
+	std::vector<U64>
+	findEdges(const EdgeExtractor::Kernel& kernel, const std::vector<U64>& words, const U64& numSamples,
+	          const size_t& maxChunkWords, std::mt19937_64& random)
+	{
+		EdgeExtractor extractor(kernel);
+		std::vector<U64> edges;
+		size_t word = 0;
+		const size_t numWords = (numSamples + samplesPerWord - 1) / samplesPerWord;
+		while (word < numWords)
+		{
+			const size_t chunkWords = std::min<size_t>(1 + random() % maxChunkWords, numWords - word);
+			const U64 chunkSamples = std::min<U64>(chunkWords * samplesPerWord, numSamples - word * samplesPerWord);
+			extractor.extract(std::span<const U64>(words.data() + word, chunkWords), chunkSamples, edges);
+			word += chunkWords;
+		}
+		if (extractor.getNumSamples() != numSamples)
+		{
+			std::printf("  %llu samples read instead of %llu\n", (unsigned long long)extractor.getNumSamples(),
+			            (unsigned long long)numSamples);
+			edges.push_back(~U64(0));	// fails the comparison
+		}
+		return edges;
+	}
+
+	const char*
+	getNameOfPattern(const Pattern& pattern)
+	{
+		switch (pattern)
+		{
+			case Pattern::random:
+				return "random";
+			case Pattern::sparse:
+				return "sparse";
+			case Pattern::wordBorders:
+				return "word borders";
+			default:
+				return "quiet";
+		}
+	}
+}
+
+int
+main()
+{
+	constexpr EdgeExtractor::Kernel kernels[] =
+	{
+		EdgeExtractor::Kernel::scalar,
+		EdgeExtractor::Kernel::sse41,
+		EdgeExtractor::Kernel::avx2,
+	};
+	constexpr Pattern patterns[] = {Pattern::random, Pattern::sparse, Pattern::wordBorders, Pattern::quiet};
+	// odd lengths, shorter than a vector, and long enough for the vector loops
+	constexpr size_t wordCounts[] = {1, 2, 3, 5, 8, 9, 17, 64, 1000};
+	constexpr size_t maxChunkWords[] = {1, 3, 7, 1 << 20};
+
+	bool failed = false;
+	for (const auto& kernel : kernels)
+	{
+		// the extractor falls back to scalar on a CPU without the kernel
+		const auto ran = EdgeExtractor(kernel).getKernel();
+		size_t numCases = 0;
+		std::mt19937_64 random(1);
+		for (const auto& pattern : patterns)
+		{
+			for (const auto& numWords : wordCounts)
+			{
+				for (const auto& maxChunk : maxChunkWords)
+				{
+					for (unsigned missing : {0u, 1u, 31u, 63u})
+					{
+						const auto words = makeWords(pattern, numWords, random);
+						const U64 numSamples = numWords * samplesPerWord - std::min<U64>(missing, numWords * samplesPerWord - 1);
+						const auto expected = findEdgesBitByBit(words, numSamples);
+						const auto edges = findEdges(kernel, words, numSamples, maxChunk, random);
+						numCases++;
+						if (edges != expected)
+						{
+							const auto mismatch = std::mismatch(edges.begin(), edges.end(), expected.begin(), expected.end());
+							std::printf("%s: %s, %zu words, %llu samples, chunks of up to %zu words: "
+							            "%zu edges instead of %zu, first difference at edge %zu\n",
+							            EdgeExtractor::getNameOfKernel(ran), getNameOfPattern(pattern), numWords,
+							            (unsigned long long)numSamples, maxChunk, edges.size(), expected.size(),
+							            size_t(mismatch.first - edges.begin()));
+							failed = true;
+						}
+					}
+				}
+			}
+		}
+		std::printf("%s%s: %zu cases\n", EdgeExtractor::getNameOfKernel(ran),
+		            ran != kernel ? " (instead of a kernel this CPU does not have)" : "", numCases);
+	}
+	return failed ? 1 : 0;
+}
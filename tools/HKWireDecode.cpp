@@ -0,0 +1,632 @@
+// Offline decoder: reads a list of edge timestamps and prints the decoded
+// HKWire commands (or words) as csv, without Logic or the Analyzer SDK.
+//
+// Input is either text (one sample number per line, `#` starts a comment)
+// or binary (little endian U64 per edge). Edges have to alternate, the
+// first one is falling unless --initial-low is given.
+// A Logic capture (*.sal) is read directly, with its own sample rate.
+// Raw samples (--raw) are one bit each, least significant first.
+
+#include "HKWireBinaryExport.h"
+#include "HKWireDecoder.h"
+#include "HKWirePcapExport.h"
+#include "HKWireRawSamples.h"
+#include "HKWireSegments.h"
+#ifdef HKWIRE_SAL
+#include "HKWireSalReader.h"
+#endif
+#include "HKWireTimeBase.h"
+#include "HKWireTransactions.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace HKWire;
+
+namespace
+{
+	struct Options
+	{
+		U64 sampleRate_Hz = 0;
+		U64 timeBase_us = 560;	// 0: detect
+		PulseTolerance tolerance;
+		double glitch_ticks = GlitchFilter::defaultWidth_ticks;
+		bool binary = false;
+		bool raw = false;
+		std::optional<EdgeExtractor::Kernel> kernel;
+		bool initialLow = false;
+		bool words = false;
+		bool transactions = false;
+		bool stats = false;
+		unsigned channel = 0;
+		unsigned jobs = 1;	// 0: every core
+		double split_ticks = SegmentedDecoder::defaultSplit_ticks;
+		const char* input = nullptr;
+		const char* output = nullptr;
+		const char* binaryExport = nullptr;
+		const char* pcapExport = nullptr;
+	};
+
+	void
+	printUsage(const char* name)
+	{
+		std::fprintf(stderr,
+			"usage: %s [options] [edge file]\n"
+			"  -r, --sample-rate HZ   sample rate of the timestamps (required, but for captures)\n"
+			"  -t, --time-base US     microseconds per tick (default 560, 0 detects it)\n"
+			"      --tolerance TICKS  accepted deviation of a low pulse (default 0.5)\n"
+			"      --tolerance-start TICKS, --tolerance-data1 TICKS, --tolerance-data0 TICKS\n"
+			"                         the same for one kind of bit only\n"
+			"  -g, --deglitch TICKS   drop levels shorter than this (default 0.1, 0 is off)\n"
+			"  -b, --binary           input is little endian U64 instead of text\n"
+			"      --raw              input is samples packed one bit each, least significant first\n"
+			"      --kernel NAME      edge search for --raw: scalar, sse4.1 or avx2 (default: best)\n"
+			"  -i, --initial-low      line is low before the first edge\n"
+			"  -c, --channel N        channel of a Logic capture (.sal) to decode (default 0)\n"
+			"  -w, --words            print single words instead of commands\n"
+			"  -x, --transactions     print answered requests instead of commands\n"
+			"  -o, --output FILE      write to FILE instead of stdout\n"
+			"  -e, --export FILE      also write the commands as binary export to FILE\n"
+			"  -p, --pcap FILE        also write the commands as pcap to FILE\n"
+			"  -j, --jobs N           decode on N threads, 0 for every core (default 1)\n"
+			"      --split TICKS      with --jobs, cut the capture at highs longer than this (default 10)\n"
+			"  -s, --stats            print throughput to stderr\n"
+			"Reads stdin if no edge file (or -) is given.\n",
+			name);
+	}
+
+	bool
+	isCapture(const char* path)
+	{
+		const size_t length = path != nullptr ? std::strlen(path) : 0;
+		return length > 4 && std::strcmp(path + length - 4, ".sal") == 0;
+	}
+
+	std::optional<Options>
+	parseArguments(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if ((arg == "-r" || arg == "--sample-rate") && hasValue)
+			{
+				options.sampleRate_Hz = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if ((arg == "-t" || arg == "--time-base") && hasValue)
+			{
+				options.timeBase_us = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if (arg == "--tolerance" && hasValue)
+			{
+				const double ticks = std::strtod(argv[++i], nullptr);
+				options.tolerance = PulseTolerance{ticks, ticks, ticks};
+			}
+			else if (arg == "--tolerance-start" && hasValue)
+			{
+				options.tolerance.start = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--tolerance-data1" && hasValue)
+			{
+				options.tolerance.data1 = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--tolerance-data0" && hasValue)
+			{
+				options.tolerance.data0 = std::strtod(argv[++i], nullptr);
+			}
+			else if ((arg == "-g" || arg == "--deglitch") && hasValue)
+			{
+				options.glitch_ticks = std::strtod(argv[++i], nullptr);
+			}
+			else if ((arg == "-o" || arg == "--output") && hasValue)
+			{
+				options.output = argv[++i];
+			}
+			else if ((arg == "-e" || arg == "--export") && hasValue)
+			{
+				options.binaryExport = argv[++i];
+			}
+			else if ((arg == "-p" || arg == "--pcap") && hasValue)
+			{
+				options.pcapExport = argv[++i];
+			}
+			else if ((arg == "-c" || arg == "--channel") && hasValue)
+			{
+				options.channel = unsigned(std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if ((arg == "-j" || arg == "--jobs") && hasValue)
+			{
+				options.jobs = unsigned(std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (arg == "--split" && hasValue)
+			{
+				options.split_ticks = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--raw")
+			{
+				options.raw = true;
+			}
+			else if (arg == "--kernel" && hasValue)
+			{
+				const std::string name = argv[++i];
+				for (const auto kernel : {EdgeExtractor::Kernel::scalar, EdgeExtractor::Kernel::sse41,
+				                          EdgeExtractor::Kernel::avx2})
+				{
+					if (name == EdgeExtractor::getNameOfKernel(kernel))
+					{
+						options.kernel = kernel;
+					}
+				}
+				if (!options.kernel.has_value())
+				{
+					return std::nullopt;
+				}
+			}
+			else if (arg == "-b" || arg == "--binary")
+			{
+				options.binary = true;
+			}
+			else if (arg == "-i" || arg == "--initial-low")
+			{
+				options.initialLow = true;
+			}
+			else if (arg == "-w" || arg == "--words")
+			{
+				options.words = true;
+			}
+			else if (arg == "-x" || arg == "--transactions")
+			{
+				options.transactions = true;
+			}
+			else if (arg == "-s" || arg == "--stats")
+			{
+				options.stats = true;
+			}
+			else if (arg == "-" || (arg[0] != '-' && options.input == nullptr))
+			{
+				options.input = argv[i];
+			}
+			else
+			{
+				return std::nullopt;
+			}
+		}
+		if (options.sampleRate_Hz == 0 && !isCapture(options.input))
+		{
+			return std::nullopt;
+		}
+		return options;
+	}
+
+	class CsvWriter : public DecoderListener
+	{
+	public:
+		CsvWriter(std::FILE* out, const Options& options)
+			: mOut{out}, mSampleRate_Hz{double(options.sampleRate_Hz)}, mWords{options.words}
+		{
+			if (options.transactions)
+			{
+				// answers come within a second, if at all
+				mTransactions.emplace(options.sampleRate_Hz);
+				std::fputs("Time [s],Src,Dst,Request,Response,Delay [ms]\n", mOut);
+			}
+			else
+			{
+				std::fputs(mWords ? "Time [s],Type,Dat\n" : "Time [s],Type,Src,Dst,Cmd,Dat\n", mOut);
+			}
+		}
+
+		void
+		onMarker(const U64&, const Marker&, const HKWireState&) override
+		{
+		}
+
+		void
+		onWord(const HKWireState& state, const U64&) override
+		{
+			if (!mWords)
+			{
+				return;
+			}
+			const auto bits = getBitsPerWord(state.wordState).value_or(8);
+			std::fprintf(mOut, "%.15f,%s,0x%0*X\n",
+			             state.startOfCurrentWord / mSampleRate_Hz,
+			             getNameOfWordState(state.wordState),
+			             int(bits / 4), unsigned(state.payload.getWord(state.wordState)));
+			numFrames++;
+		}
+
+		void
+		onCommand(const CommandRecord& record) override
+		{
+			if (binaryExport != nullptr)
+			{
+				binaryExport->add(record);
+			}
+			if (pcapExport != nullptr)
+			{
+				pcapExport->add(record);
+			}
+			const auto& payload = record.payload;
+			if (mTransactions.has_value())
+			{
+				const auto answered = mTransactions->onCommand(record, numFrames);
+				if (answered.has_value())
+				{
+					// printed from the view of the request
+					std::fprintf(mOut, "%.15f,0x%X,0x%X,0x%02X,0x%02X,%.3f\n",
+					             answered->requestStart / mSampleRate_Hz,
+					             unsigned(payload.dest), unsigned(payload.source),
+					             unsigned(answered->request), unsigned(payload.command),
+					             (record.start - answered->requestStart) * 1000 / mSampleRate_Hz);
+				}
+				numFrames++;
+				return;
+			}
+			if (mWords)
+			{
+				return;
+			}
+			const bool withData = payload.data1.has_value();
+			std::fprintf(mOut, "%.15f,%s,0x%X,0x%X,0x%02X",
+			             record.start / mSampleRate_Hz,
+			             withData ? "command with data" : "command",
+			             unsigned(payload.source), unsigned(payload.dest), unsigned(payload.command));
+			if (withData)
+			{
+				std::fprintf(mOut, payload.data2.has_value() ? ",0x%04X" : ",0x%02X",
+				             unsigned(payload.getDataInHostOrder()));
+			}
+			std::fputc('\n', mOut);
+			numFrames++;
+		}
+
+		U64 numFrames = 0;
+		BinaryExporter* binaryExport = nullptr;
+		PcapExporter* pcapExport = nullptr;
+
+	private:
+		std::FILE* mOut;
+		const double mSampleRate_Hz;
+		const bool mWords;
+		std::optional<TransactionMatcher> mTransactions;
+	};
+
+	// Text input: every run of digits is one timestamp.
+	class TextEdgeParser
+	{
+	public:
+		template<typename Sink>
+		void
+		parse(const char* data, size_t length, Sink&& sink)
+		{
+			for (size_t i = 0; i < length; i++)
+			{
+				const char c = data[i];
+				if (mInComment)
+				{
+					mInComment = c != '\n';
+				}
+				else if (c >= '0' && c <= '9')
+				{
+					mValue = mValue * 10 + U64(c - '0');
+					mInNumber = true;
+				}
+				else
+				{
+					flush(sink);
+					mInComment = c == '#';
+				}
+			}
+		}
+
+		template<typename Sink>
+		void
+		flush(Sink&& sink)
+		{
+			if (mInNumber)
+			{
+				sink(mValue);
+			}
+			mValue = 0;
+			mInNumber = false;
+		}
+
+	private:
+		U64 mValue = 0;
+		bool mInNumber = false;
+		bool mInComment = false;
+	};
+}
+
+int
+main(int argc, char** argv)
+{
+	const auto maybeOptions = parseArguments(argc, argv);
+	if (!maybeOptions.has_value())
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+	auto options = *maybeOptions;
+
+	std::FILE* in = stdin;
+#ifdef HKWIRE_SAL
+	std::optional<SalReader> capture;
+	if (isCapture(options.input))
+	{
+		capture.emplace(options.input, options.channel);
+		if (!capture->isOpen())
+		{
+			std::fprintf(stderr, "%s: %s\n", options.input, capture->getError().c_str());
+			return 1;
+		}
+		options.sampleRate_Hz = capture->getSampleRate_Hz();
+		options.initialLow = capture->isInitialLow();
+	}
+	else
+#else
+	if (isCapture(options.input))
+	{
+		std::fprintf(stderr, "%s: built without zlib, can not read captures\n", options.input);
+		return 1;
+	}
+#endif
+	if (options.input != nullptr && std::strcmp(options.input, "-") != 0)
+	{
+		in = std::fopen(options.input, "rb");
+		if (in == nullptr)
+		{
+			std::perror(options.input);
+			return 1;
+		}
+	}
+	std::FILE* out = stdout;
+	if (options.output != nullptr)
+	{
+		out = std::fopen(options.output, "wb");
+		if (out == nullptr)
+		{
+			std::perror(options.output);
+			return 1;
+		}
+	}
+	static char outBuffer[1 << 16];
+	std::setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+
+	const bool detectTimeBase = options.timeBase_us == 0;
+	auto tickLength = TickLength::fromTimeBase(detectTimeBase ? 560 : options.timeBase_us, options.sampleRate_Hz);
+	if (tickLength.raw < TickLength::one && !detectTimeBase)
+	{
+		std::fprintf(stderr, "sample rate too low for a time base of %llu us\n",
+		             static_cast<unsigned long long>(options.timeBase_us));
+		return 2;
+	}
+
+	std::optional<ExportWriter> exportWriter;
+	std::optional<BinaryExporter> binaryExport;
+	if (options.binaryExport != nullptr)
+	{
+		exportWriter.emplace(options.binaryExport);
+		if (!exportWriter->isOpen())
+		{
+			std::perror(options.binaryExport);
+			return 1;
+		}
+		binaryExport.emplace(*exportWriter, options.sampleRate_Hz, 0);
+	}
+	std::optional<ExportWriter> pcapWriter;
+	std::optional<PcapExporter> pcapExport;
+	if (options.pcapExport != nullptr)
+	{
+		pcapWriter.emplace(options.pcapExport);
+		if (!pcapWriter->isOpen())
+		{
+			std::perror(options.pcapExport);
+			return 1;
+		}
+		pcapExport.emplace(*pcapWriter, options.sampleRate_Hz);
+	}
+
+	CsvWriter writer(out, options);
+	writer.binaryExport = binaryExport.has_value() ? &*binaryExport : nullptr;
+	writer.pcapExport = pcapExport.has_value() ? &*pcapExport : nullptr;
+	// created with the first edges, they might be needed to find the time base
+	std::optional<Decoder> decoder;
+
+	const auto begin = std::chrono::steady_clock::now();
+
+	// a line starting low has no usable first pulse, so drop the first (rising) edge
+	bool skipEdge = options.initialLow;
+	U64 numEdges = 0;
+	std::vector<U64> edges;
+	edges.reserve(1 << 16);
+	const auto detect = [&](std::span<const U64> span)
+	{
+		std::vector<U64> lowPulses;
+		for (size_t i = 0; i + 1 < span.size() && lowPulses.size() < TimeBase::detectionPulses; i += 2)
+		{
+			lowPulses.push_back(span[i + 1] - span[i]);
+		}
+		if (const auto detected = TimeBase::detectTickLength(lowPulses))
+		{
+			tickLength = *detected;
+		}
+		else
+		{
+			std::fputs("could not detect the time base, assuming 560 us\n", stderr);
+		}
+		if (options.stats)
+		{
+			std::fprintf(stderr, "%.3f samples per tick\n", double(tickLength.raw) / TickLength::one);
+		}
+	};
+	// the parallel decoder wants the whole capture at once
+	const bool parallel = options.jobs != 1;
+	std::vector<U64> allEdges;
+	const auto feed = [&]()
+	{
+		std::span<const U64> span(edges);
+		if (skipEdge && !span.empty())
+		{
+			span = span.subspan(1);
+			skipEdge = false;
+		}
+		if (parallel)
+		{
+			allEdges.insert(allEdges.end(), span.begin(), span.end());
+			numEdges += edges.size();
+			edges.clear();
+			return;
+		}
+		if (!decoder.has_value())
+		{
+			if (detectTimeBase)
+			{
+				detect(span);
+			}
+			decoder.emplace(writer, tickLength, options.tolerance, options.glitch_ticks);
+		}
+		decoder->decode(span);
+		numEdges += edges.size();
+		edges.clear();
+	};
+
+	bool readFailed = false;
+#ifdef HKWIRE_SAL
+	if (capture.has_value())
+	{
+		// a block at a time, the capture is never unpacked as a whole
+		while (capture->read(edges))
+		{
+			feed();
+		}
+		if (!capture->isOpen())
+		{
+			std::fprintf(stderr, "%s: %s\n", options.input, capture->getError().c_str());
+			readFailed = true;
+		}
+	}
+	else
+#endif
+	if (options.raw)
+	{
+		EdgeExtractor extractor(options.kernel);
+		// a few seconds at hundreds of MHz, most of it without a single edge
+		std::vector<U64> words(1 << 20);
+		size_t read;
+		while ((read = std::fread(words.data(), 1, words.size() * sizeof(U64), in)) > 0)
+		{
+			// like --binary, little endian is assumed. A short read only happens at the end.
+			const size_t numWords = (read + sizeof(U64) - 1) / sizeof(U64);
+			std::memset(reinterpret_cast<char*>(words.data()) + read, 0, numWords * sizeof(U64) - read);
+			const bool first = extractor.getNumSamples() == 0;
+			extractor.extract(std::span<const U64>(words.data(), numWords), U64(read) * 8, edges);
+			if (first)
+			{
+				skipEdge = !extractor.getInitialLevel();
+			}
+			feed();
+		}
+		if (options.stats)
+		{
+			std::fprintf(stderr, "%llu samples, %s edge search\n",
+			             static_cast<unsigned long long>(extractor.getNumSamples()),
+			             EdgeExtractor::getNameOfKernel(extractor.getKernel()));
+		}
+	}
+	else if (options.binary)
+	{
+		edges.resize(edges.capacity());
+		size_t read;
+		while ((read = std::fread(edges.data(), 1, edges.capacity() * sizeof(U64), in)) > 0)
+		{
+			// fread only comes back short at the end, so a partial edge means the file was cut off
+			edges.resize(read / sizeof(U64));
+			feed();
+			if (read % sizeof(U64) != 0)
+			{
+				std::fprintf(stderr, "%s: truncated, %zu bytes after the last edge\n",
+				             in == stdin ? "stdin" : options.input, read % sizeof(U64));
+				readFailed = true;
+				break;
+			}
+			edges.resize(edges.capacity());
+		}
+		edges.clear();
+	}
+	else
+	{
+		TextEdgeParser parser;
+		const auto sink = [&](const U64& edge)
+		{
+			edges.push_back(edge);
+		};
+		std::vector<char> buffer(1 << 16);
+		size_t read;
+		while ((read = std::fread(buffer.data(), 1, buffer.size(), in)) > 0)
+		{
+			parser.parse(buffer.data(), read, sink);
+			feed();
+		}
+		parser.flush(sink);
+		feed();
+	}
+	if (decoder.has_value())
+	{
+		decoder->finish();
+	}
+	std::optional<SegmentedDecoder> segmented;
+	if (parallel)
+	{
+		if (detectTimeBase)
+		{
+			detect(allEdges);
+		}
+		segmented.emplace(tickLength, options.tolerance, options.glitch_ticks, options.split_ticks, options.jobs);
+		segmented->decode(allEdges, writer);
+	}
+	bool exported = true;
+	if (binaryExport.has_value())
+	{
+		binaryExport->finish();
+		exported = exportWriter->close();
+	}
+	if (pcapWriter.has_value())
+	{
+		exported &= pcapWriter->close();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+	if (options.stats)
+	{
+		std::fprintf(stderr, "%llu edges, %llu frames in %.3f s (%.1f Medges/s)\n",
+		             static_cast<unsigned long long>(numEdges),
+		             static_cast<unsigned long long>(writer.numFrames),
+		             elapsed.count(), numEdges / elapsed.count() / 1e6);
+		if (decoder.has_value())
+		{
+			std::fprintf(stderr, "%llu glitches suppressed, %.3f s in broken transmissions\n",
+			             static_cast<unsigned long long>(decoder->getNumSuppressedGlitches()),
+			             double(decoder->getLostSamples()) / options.sampleRate_Hz);
+		}
+		if (segmented.has_value())
+		{
+			std::fprintf(stderr, "%llu segments, %llu glitches suppressed, %.3f s in broken transmissions\n",
+			             static_cast<unsigned long long>(segmented->getNumSegments()),
+			             static_cast<unsigned long long>(segmented->getNumSuppressedGlitches()),
+			             double(segmented->getLostSamples()) / options.sampleRate_Hz);
+		}
+	}
+
+	if (in != stdin)
+	{
+		std::fclose(in);
+	}
+	return std::fclose(out) == 0 && exported && !readFailed ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+// Generates HKWire bus traffic as edge timestamps, in the input format of
+// hkwire-decode. The line idles high, so the first edge is falling.
+//
+// With --raw, the samples themselves are written instead, one bit each.
+//
+// Optionally writes the generated commands in the csv format of
+// hkwire-decode, so a round trip can be checked with a plain diff.
+
+#include "HKWireTrafficGenerator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace HKWire;
+
+namespace
+{
+	struct Options
+	{
+		TrafficConfig config;
+		U64 numCommands = 100;
+		bool binary = false;
+		bool raw = false;
+		const char* output = nullptr;
+		const char* expected = nullptr;
+	};
+
+	void
+	printUsage(const char* name)
+	{
+		std::fprintf(stderr,
+			"usage: %s [options]\n"
+			"  -r, --sample-rate HZ     sample rate of the timestamps (required)\n"
+			"  -t, --time-base US       microseconds per tick (default 560)\n"
+			"  -n, --commands N         number of commands (default 100)\n"
+			"  -c, --command-rate HZ    commands per second (default 10)\n"
+			"  -j, --jitter TICKS       max. timing error of every level (default 0.1)\n"
+			"      --clock-offset RATIO sender ticks are longer by this (default 0)\n"
+			"      --drift RATIO        max. change of the sender clock per transmission (default 0)\n"
+			"      --data8 RATIO        share of commands with one data byte (default 0.2)\n"
+			"      --data16 RATIO       share of commands with two data bytes (default 0.2)\n"
+			"  -g, --glitches RATIO     chance of a glitch in every level (default 0)\n"
+			"      --glitch-width TICKS width of a glitch (default 0.05)\n"
+			"      --seed N             random seed\n"
+			"  -b, --binary             write little endian U64 instead of text\n"
+			"      --raw                write the samples packed one bit each, least significant first\n"
+			"  -o, --output FILE        write edges to FILE instead of stdout\n"
+			"  -e, --expected FILE      write the generated commands as csv to FILE\n",
+			name);
+	}
+
+	std::optional<Options>
+	parseArguments(int argc, char** argv)
+	{
+		Options options;
+		auto& config = options.config;
+		config.sampleRate_Hz = 0;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if ((arg == "-r" || arg == "--sample-rate") && hasValue)
+			{
+				config.sampleRate_Hz = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if ((arg == "-t" || arg == "--time-base") && hasValue)
+			{
+				config.timeBase_us = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if ((arg == "-n" || arg == "--commands") && hasValue)
+			{
+				options.numCommands = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if ((arg == "-c" || arg == "--command-rate") && hasValue)
+			{
+				config.commandsPerSecond = std::strtod(argv[++i], nullptr);
+			}
+			else if ((arg == "-j" || arg == "--jitter") && hasValue)
+			{
+				config.tickJitter = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--clock-offset" && hasValue)
+			{
+				config.clockOffset = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--drift" && hasValue)
+			{
+				config.clockDrift = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--data8" && hasValue)
+			{
+				config.data8Ratio = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--data16" && hasValue)
+			{
+				config.data16Ratio = std::strtod(argv[++i], nullptr);
+			}
+			else if ((arg == "-g" || arg == "--glitches") && hasValue)
+			{
+				config.glitchProbability = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--glitch-width" && hasValue)
+			{
+				config.glitchWidth = std::strtod(argv[++i], nullptr);
+			}
+			else if (arg == "--seed" && hasValue)
+			{
+				config.seed = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if ((arg == "-o" || arg == "--output") && hasValue)
+			{
+				options.output = argv[++i];
+			}
+			else if ((arg == "-e" || arg == "--expected") && hasValue)
+			{
+				options.expected = argv[++i];
+			}
+			else if (arg == "--raw")
+			{
+				options.raw = true;
+			}
+			else if (arg == "-b" || arg == "--binary")
+			{
+				options.binary = true;
+			}
+			else
+			{
+				return std::nullopt;
+			}
+		}
+		if (config.sampleRate_Hz == 0 || config.timeBase_us == 0)
+		{
+			return std::nullopt;
+		}
+		return options;
+	}
+
+	void
+	writeCommand(std::FILE* out, const Payload& payload, const double& time_s)
+	{
+		const bool withData = payload.data1.has_value();
+		std::fprintf(out, "%.15f,%s,0x%X,0x%X,0x%02X",
+		             time_s,
+		             withData ? "command with data" : "command",
+		             unsigned(payload.source), unsigned(payload.dest), unsigned(payload.command));
+		if (withData)
+		{
+			std::fprintf(out, payload.data2.has_value() ? ",0x%04X" : ",0x%02X",
+			             unsigned(payload.getDataInHostOrder()));
+		}
+		std::fputc('\n', out);
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	const auto maybeOptions = parseArguments(argc, argv);
+	if (!maybeOptions.has_value())
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+	const auto& options = *maybeOptions;
+
+	std::FILE* out = stdout;
+	if (options.output != nullptr)
+	{
+		out = std::fopen(options.output, "wb");
+		if (out == nullptr)
+		{
+			std::perror(options.output);
+			return 1;
+		}
+	}
+	static char outBuffer[1 << 16];
+	std::setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+
+	std::FILE* expected = nullptr;
+	if (options.expected != nullptr)
+	{
+		expected = std::fopen(options.expected, "wb");
+		if (expected == nullptr)
+		{
+			std::perror(options.expected);
+			return 1;
+		}
+		std::fputs("Time [s],Type,Src,Dst,Cmd,Dat\n", expected);
+	}
+
+	// packed samples, the line idles high
+	U64 rawWord = 0;
+	U64 rawSample = 0;
+	bool rawLevel = true;
+	const auto writeRawUntil = [&](const U64& sample)
+	{
+		for (; rawSample < sample; rawSample++)
+		{
+			rawWord |= U64(rawLevel) << (rawSample % 64);
+			if (rawSample % 64 == 63)
+			{
+				std::fwrite(&rawWord, sizeof(rawWord), 1, out);
+				rawWord = 0;
+			}
+		}
+	};
+
+	TrafficGenerator generator(options.config);
+	U64 numTransmissions = 0;
+	while (true)
+	{
+		const auto edge = generator.nextEdge();
+		if (generator.getNumTransmissions() > options.numCommands)
+		{
+			// this is already the next one, the line stays idle instead
+			break;
+		}
+		if (generator.getNumTransmissions() != numTransmissions)
+		{
+			numTransmissions = generator.getNumTransmissions();
+			if (expected != nullptr)
+			{
+				writeCommand(expected, generator.getCurrentPayload(),
+				             double(generator.getStartOfTransmission()) / options.config.sampleRate_Hz);
+			}
+		}
+		if (options.raw)
+		{
+			writeRawUntil(edge);
+			rawLevel = !rawLevel;
+		}
+		else if (options.binary)
+		{
+			std::fwrite(&edge, sizeof(edge), 1, out);
+		}
+		else
+		{
+			std::fprintf(out, "%llu\n", static_cast<unsigned long long>(edge));
+		}
+	}
+
+	if (options.raw)
+	{
+		// a tick of idle line, up to the next full word
+		writeRawUntil(rawSample + getSamplesPerTick(options.config.timeBase_us, options.config.sampleRate_Hz));
+		writeRawUntil((rawSample + 63) / 64 * 64);
+	}
+
+	if (expected != nullptr && std::fclose(expected) != 0)
+	{
+		return 1;
+	}
+	return std::fclose(out) == 0 ? 0 : 1;
+}